@@ -20,6 +20,12 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Threads sleeping in timer_sleep(), ordered by wake up tick. */
+static struct treap sleep_treap;
+/* Wake up tick of the front of sleep_treap, INT64_MAX if empty.
+   Lets a tick with nobody due skip the treap entirely. */
+static int64_t next_wakeup_tick;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -29,6 +35,7 @@ static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void timer_wakeup (void);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -36,6 +43,9 @@ void
 timer_init (void) 
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
+  /* Init the sleep treap with nobody to wake up */
+  treap_init (&sleep_treap, thread_sleep_treap_cmp);
+  next_wakeup_tick = INT64_MAX;
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -96,7 +106,12 @@ timer_sleep (int64_t ticks)
   /* ensure atomic */
   enum intr_level old_level = intr_disable ();
   /* calculate how long to block and block itseft */
-  thread_current ()->ticks_to_unblock = start + ticks;
+  struct thread *cur = thread_current ();
+  cur->ticks_to_unblock = start + ticks;
+  /* Queue into the sleep treap and maintain the earliest wake up tick */
+  treap_insert (&sleep_treap, &cur->sleep_node);
+  if (cur->ticks_to_unblock < next_wakeup_tick)
+    next_wakeup_tick = cur->ticks_to_unblock;
   thread_block ();
   intr_set_level (old_level);
 }
@@ -178,7 +193,7 @@ timer_interrupt (struct intr_frame *args UNUSED)
   ticks++;
   thread_tick ();
   /* check any thread unblock */
-  thread_foreach (thread_unblock_check, (void *)&ticks);
+  timer_wakeup ();
   if (thread_mlfqs)
     {
       /* increase recent cpu */
@@ -262,12 +277,37 @@ real_time_delay (int64_t num, int32_t denom)
   busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
 }
 
+/* Unblocks every sleeping thread whose wake up tick has come.
+   Costs O(1) when nobody is due.  Interrupts must be off. */
+static void
+timer_wakeup (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (ticks >= next_wakeup_tick)
+    {
+      struct thread *th
+          = (struct thread *)treap_pop_front (&sleep_treap)->data;
+      th->ticks_to_unblock = THREAD_TICKS_TO_UNBLOCK_NO_TICKS;
+      thread_unblock (th);
+      /* Refresh the earliest wake up tick */
+      if (treap_size (&sleep_treap))
+        next_wakeup_tick = ((struct thread *)treap_front (&sleep_treap)->data)
+                               ->ticks_to_unblock;
+      else
+        next_wakeup_tick = INT64_MAX;
+    }
+}
+
 void
 mlfqs_update ()
 {
   /* ensure atomic */
   enum intr_level old_level = intr_disable ();
   thread_calc_load_avg ();
-  thread_foreach (thread_calc_recent_cpu, NULL);
+  if (thread_mlfqs_lazy)
+    thread_decay_recent_cpu_lazy ();
+  else
+    thread_foreach (thread_calc_recent_cpu, NULL);
   intr_set_level (old_level);
 }
\ No newline at end of file
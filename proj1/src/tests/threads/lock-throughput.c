@@ -0,0 +1,69 @@
+/* Measures lock throughput, in acquire/release pairs per timer
+   tick, first with a single thread that never contends and then
+   with several threads of equal priority that yield while holding
+   the lock, so that every acquire contends.
+
+   The numbers depend on the simulator and host, so only their
+   presence is checked. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define BENCH_TICKS (5 * TIMER_FREQ)
+#define THREAD_CNT 4
+
+static thread_func contended_thread;
+static struct lock lock;
+static struct semaphore done;
+static int64_t deadline;
+static long long pairs;
+
+void
+test_lock_throughput (void) 
+{
+  int i;
+
+  lock_init (&lock);
+  sema_init (&done, 0);
+
+  /* Uncontended: nobody else wants the lock. */
+  pairs = 0;
+  deadline = timer_ticks () + BENCH_TICKS;
+  while (timer_ticks () < deadline)
+    {
+      lock_acquire (&lock);
+      pairs++;
+      lock_release (&lock);
+    }
+  msg ("uncontended: %lld pairs per tick.", pairs / BENCH_TICKS);
+
+  /* Contended: THREAD_CNT threads hand the lock around. */
+  pairs = 0;
+  deadline = timer_ticks () + BENCH_TICKS;
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "contender %d", i);
+      thread_create (name, PRI_DEFAULT, contended_thread, NULL);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  msg ("contended: %lld pairs per tick.", pairs / BENCH_TICKS);
+}
+
+static void
+contended_thread (void *aux UNUSED) 
+{
+  while (timer_ticks () < deadline)
+    {
+      lock_acquire (&lock);
+      pairs++;
+      thread_yield ();
+      lock_release (&lock);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+foreach my $kind ('uncontended', 'contended') {
+    grep (/^\(lock-throughput\) $kind: \d+ pairs per tick\.$/, @output)
+      or fail "missing $kind throughput\n";
+}
+pass;
@@ -0,0 +1,60 @@
+/* The main thread acquires a lock while nobody waits for it and
+   lowers its priority.  Then it creates a thread whose priority
+   lies between its old and new ones, which blocks acquiring the
+   lock, and must still donate its priority to the main thread.
+   A thread of lower priority than the donation, created next,
+   must not run before the lock is released. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func acquire_thread_func;
+static thread_func medium_thread_func;
+
+void
+test_priority_donate_lower_first (void) 
+{
+  struct lock lock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&lock);
+  lock_acquire (&lock);
+  msg ("Lowering base priority...");
+  thread_set_priority (PRI_DEFAULT - 10);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT - 10, thread_get_priority ());
+
+  thread_create ("acquire", PRI_DEFAULT - 5, acquire_thread_func, &lock);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT - 5, thread_get_priority ());
+  thread_create ("medium", PRI_DEFAULT - 8, medium_thread_func, NULL);
+  msg ("Main thread releasing the lock.");
+  lock_release (&lock);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT - 10, thread_get_priority ());
+}
+
+static void
+acquire_thread_func (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  msg ("acquire: got the lock");
+  lock_release (lock);
+  msg ("acquire: done");
+}
+
+static void
+medium_thread_func (void *aux UNUSED) 
+{
+  msg ("medium: done");
+}
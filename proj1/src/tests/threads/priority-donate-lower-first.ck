@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-lower-first) begin
+(priority-donate-lower-first) Lowering base priority...
+(priority-donate-lower-first) Main thread should have priority 21.  Actual priority: 21.
+(priority-donate-lower-first) Main thread should have priority 26.  Actual priority: 26.
+(priority-donate-lower-first) Main thread releasing the lock.
+(priority-donate-lower-first) acquire: got the lock
+(priority-donate-lower-first) acquire: done
+(priority-donate-lower-first) medium: done
+(priority-donate-lower-first) Main thread should have priority 21.  Actual priority: 21.
+(priority-donate-lower-first) end
+EOF
+pass;
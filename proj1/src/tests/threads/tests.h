@@ -18,13 +18,16 @@ extern test_func test_priority_donate_multiple2;
 extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
+extern test_func test_priority_donate_lower_first;
 extern test_func test_priority_donate_chain;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_lock_throughput;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
+extern test_func test_mlfqs_load_600;
 extern test_func test_mlfqs_load_avg;
 extern test_func test_mlfqs_recent_1;
 extern test_func test_mlfqs_fair_2;
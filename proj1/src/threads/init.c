@@ -256,6 +256,10 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-mlfqs-lazy"))
+        thread_mlfqs = thread_mlfqs_lazy = true;
+      else if (!strcmp (name, "-rqbitmap"))
+        thread_ready_bitmap = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -379,6 +383,8 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -mlfqs-lazy        Same, but decay blocked threads lazily.\n"
+          "  -rqbitmap          Use bitmap-indexed ready queue, not treap.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -32,6 +32,10 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* max_priority of a lock nobody donated to, below any priority so
+   that the first waiter always donates */
+#define LOCK_NO_DONATION (PRI_MIN - 1)
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -105,6 +109,38 @@ sema_try_down (struct semaphore *sema)
   return success;
 }
 
+/* Increments SEMA's value and unblocks the waiting thread with the
+   highest priority, if any, without preempting the running thread.
+   Returns the unblocked thread, or a null pointer if nobody waits.
+   Interrupts must be off. */
+static struct thread *
+sema_wake (struct semaphore *sema)
+{
+  struct thread *t = NULL;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Unblock the waiting thread with the highest priority */
+  if (treap_size (&sema->waiters))
+    {
+      t = (struct thread *)treap_pop_front (&sema->waiters)->data;
+      thread_unblock (t);
+    }
+  sema->value++;
+  return t;
+}
+
+/* Yields the CPU to a higher priority thread that became ready,
+   deferring the yield to interrupt return inside a handler. */
+static void
+sema_preempt (void)
+{
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
+    thread_yield ();
+}
+
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
 
@@ -118,12 +154,11 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
 
-  /* Unblock the waiting thread with the highest priority */
-  if (treap_size (&sema->waiters))
-    thread_unblock ((struct thread *)treap_pop_front (&sema->waiters)->data);
-  sema->value++;
-  /* Ensure higher priority thread run first */
-  thread_yield ();
+  struct thread *t = sema_wake (sema);
+  /* Ensure higher priority thread run first, only preempt when the
+     woken thread outranks the current one */
+  if (t != NULL && t->priority > thread_current ()->priority)
+    sema_preempt ();
 
   intr_set_level (old_level);
 }
@@ -187,6 +222,7 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->max_priority = LOCK_NO_DONATION;
   /* Init treap node element */
   treap_node_init (&lock->node, lock);
 }
@@ -250,17 +286,26 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock)
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!thread_mlfqs)
+  /* The lock is in holding_locks only if some thread donated to it */
+  bool donated = lock->node.treap != NULL;
+  if (donated)
     {
       /* Apply thread release lock event */
       thread_release_lock (lock);
     }
 
+  old_level = intr_disable ();
   lock->holder = NULL;
-  sema_up (&lock->semaphore);
+  struct thread *t = sema_wake (&lock->semaphore);
+  /* Losing a donation may also let a ready thread outrank us */
+  if (donated || (t != NULL && t->priority > thread_current ()->priority))
+    thread_yield ();
+  intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -365,7 +410,11 @@ cond_broadcast (struct condition *cond, struct lock *lock)
     cond_signal (cond, lock);
 }
 
-/* When success, apply lock hold event */
+/* When success, apply lock hold event.
+   The lock joins the holder's holding_locks treap only once a waiter
+   donates to it (see lock_acquire_fail()), so an uncontended
+   acquire and release never touch a treap.  Threads still waiting
+   donated to the previous holder, they donate to the new one here. */
 void
 lock_acquire_success (struct lock *lock)
 {
@@ -376,8 +425,16 @@ lock_acquire_success (struct lock *lock)
     {
       /* Hold lock */
       cur->waiting_lock = NULL;
-      lock->max_priority = cur->priority;
-      thread_hold_lock (lock);
+      lock->max_priority = LOCK_NO_DONATION;
+      if (treap_size (&lock->semaphore.waiters))
+        {
+          lock->max_priority
+              = ((struct thread *)treap_front (&lock->semaphore.waiters)
+                     ->data)
+                    ->priority;
+          treap_insert (&cur->holding_locks, &lock->node);
+          thread_update_priority (cur);
+        }
     }
   /* Hold lock */
   lock->holder = cur;
@@ -405,7 +462,9 @@ lock_acquire_fail (struct lock *lock)
         break;
       /* Update the treap info */
       /* First do erase and then update, finally insert back */
-      treap_erase (&l->holder->holding_locks, &l->node);
+      /* The first donation to a lock adds it to holding_locks */
+      if (l->node.treap)
+        treap_erase (&l->holder->holding_locks, &l->node);
       l->max_priority = cur->priority;
       treap_insert (&l->holder->holding_locks, &l->node);
       /* Distribute the lock info into thread */
@@ -27,7 +27,8 @@ struct lock
   struct semaphore semaphore; /* Binary semaphore controlling access. */
 
   struct treap_node node; /* Treap node for holding_locks */
-  int max_priority;       /* Max priority among threads that are waiting */
+  int max_priority;       /* Max priority among threads that are waiting,
+                             LOCK_NO_DONATION while not in holding_locks */
 };
 
 void lock_init (struct lock *);
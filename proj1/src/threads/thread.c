@@ -22,6 +22,13 @@
 
 static fp32_t load_avg;
 
+/* Lazy mlfqs: number of recent_cpu decays done so far, and the decay
+   factor 2*load_avg/(2*load_avg+1) of the latest MLFQS_DECAY_TABLE_SIZE
+   of them, indexed by epoch modulo the table size. */
+#define MLFQS_DECAY_TABLE_SIZE 64
+static int mlfqs_epoch;
+static fp32_t mlfqs_decay_table[MLFQS_DECAY_TABLE_SIZE];
+
 /* List of processes in THREAD_READY state, that is, processes
    that are ready to run but not actually running. */
 /* static struct list ready_list; */
@@ -30,6 +37,15 @@ static struct treap ready_treap;
 /* Ensure fifo property when priority is equal */
 static uint64_t thread_ready_treap_fifo;
 
+/* Bitmap-indexed ready queue, used instead of ready_treap when
+   thread_ready_bitmap is set: one FIFO list per priority and a bit
+   per non-empty list, so push, pop and priority moves are O(1). */
+static struct list ready_lists[PRI_MAX + 1];
+/* Bit i is set iff ready_lists[i] is not empty */
+static uint64_t ready_lists_bitmap;
+/* Number of threads in ready_lists */
+static int ready_lists_size;
+
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
@@ -65,6 +81,17 @@ static unsigned thread_ticks; /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If false (default), decay every thread's recent_cpu each second.
+   If true, decay only running and ready threads each second and let
+   blocked threads catch up when they are unblocked.
+   Controlled by kernel command-line option "-mlfqs-lazy". */
+bool thread_mlfqs_lazy;
+
+/* If false (default), keep ready threads in a treap.
+   If true, use the bitmap-indexed multi-level ready queue.
+   Controlled by kernel command-line option "-rqbitmap". */
+bool thread_ready_bitmap;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -76,6 +103,12 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_queue_push (struct thread *);
+static struct thread *ready_queue_pop (void);
+static int ready_queue_size (void);
+static void ready_queue_priority_update (struct thread *, int priority);
+static int thread_mlfqs_priority (struct thread *);
+static void thread_catch_up_recent_cpu (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -101,8 +134,14 @@ thread_init (void)
   thread_ready_treap_fifo = 0;
   /* Init ready treap */
   treap_init (&ready_treap, thread_priority_treap_cmp);
+  /* Init bitmap-indexed ready queue */
+  for (int i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&ready_lists[i]);
+  ready_lists_bitmap = 0;
+  ready_lists_size = 0;
   /* Init load_avg */
   load_avg = int_to_fp32(0);
+  mlfqs_epoch = 0;
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -251,14 +290,15 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
+  /* Apply the recent_cpu decays missed while blocked */
+  if (thread_mlfqs_lazy && t != idle_thread)
+    {
+      thread_catch_up_recent_cpu (t);
+      t->priority = thread_mlfqs_priority (t);
+    }
   /* list_push_back (&ready_list, &t->elem); */
-  /* Ensure fifo when priority is equal */
-  t->ready_treap_fifo = ++thread_ready_treap_fifo;
-#ifdef _MDEBUG
-  ASSERT (t->node.data == t);
-#endif
-  /* Insert current thread into ready treap */
-  treap_insert (&ready_treap, &t->node);
+  /* Insert current thread into ready queue */
+  ready_queue_push (t);
 
   t->status = THREAD_READY;
   intr_set_level (old_level);
@@ -332,13 +372,8 @@ thread_yield (void)
   if (cur != idle_thread)
     {
       /* list_push_back (&ready_list, &cur->elem); */
-      /* Ensure fifo property when priority is equal */
-      cur->ready_treap_fifo = ++thread_ready_treap_fifo;
-#ifdef _MDEBUG
-      ASSERT (cur == cur->node.data);
-#endif
-      /* Insert the current thread into ready treap */
-      treap_insert (&ready_treap, &cur->node);
+      /* Insert the current thread into ready queue */
+      ready_queue_push (cur);
     }
   cur->status = THREAD_READY;
   schedule ();
@@ -374,13 +409,11 @@ thread_set_priority (int new_priority)
   int old_priority = cur->priority;
   /* Modify base priority */
   cur->base_priority = new_priority;
-  /* Only when priority increase or need to donate to holding locks */
-  /* we change the priority */
-  if (!treap_size (&cur->holding_locks) || new_priority > old_priority)
-    {
-      cur->priority = new_priority;
-      thread_yield ();
-    }
+  /* Donations to the holding locks still count */
+  thread_update_priority (cur);
+  /* A ready thread may outrank us now */
+  if (cur->priority < old_priority)
+    thread_yield ();
   /* Recover intr level */
   intr_set_level (old_level);
 }
@@ -506,9 +539,9 @@ init_thread (struct thread *t, const char *name, int priority)
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
 
+  memset (t, 0, sizeof *t);
   /* init TICKS_TO_UNLOCK to -1 */
   t->ticks_to_unblock = THREAD_TICKS_TO_UNBLOCK_NO_TICKS;
-  memset (t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *)t + PGSIZE;
@@ -521,6 +554,7 @@ init_thread (struct thread *t, const char *name, int priority)
   t->ready_treap_fifo = 0;
   /* Init treap node element */
   treap_node_init (&t->node, t);
+  treap_node_init (&t->sleep_node, t);
   /* Store the base priority */
   t->base_priority = priority;
   /* Init holding locks treap */
@@ -530,6 +564,7 @@ init_thread (struct thread *t, const char *name, int priority)
   /* Init nice value and recent cpu */
   t->nice = 0;
   t->recent_cpu = int_to_fp32 (0);
+  t->recent_cpu_epoch = mlfqs_epoch;
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
@@ -557,17 +592,108 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void)
 {
-  if (treap_size (&ready_treap) == 0)
+  if (ready_queue_size () == 0)
     {
       return idle_thread;
     }
   else
     {
       /* Get the thread with highest priority */
-      return (struct thread *)(treap_pop_front (&ready_treap)->data);
+      return ready_queue_pop ();
     }
 }
 
+/* Returns the index of the highest set bit in non-zero BITS. */
+static int
+ready_lists_highest (uint64_t bits)
+{
+  ASSERT (bits != 0);
+  /* Split into two words so that only 32-bit bsr is needed */
+  uint32_t high = (uint32_t)(bits >> 32);
+  if (high)
+    return 63 - __builtin_clz (high);
+  return 31 - __builtin_clz ((uint32_t)bits);
+}
+
+/* Inserts T into the ready queue of the selected backend.
+   Interrupts must be off. */
+static void
+ready_queue_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_ready_bitmap)
+    {
+      /* Append to the FIFO list of its priority and mark it non-empty */
+      list_push_back (&ready_lists[t->priority], &t->elem);
+      ready_lists_bitmap |= (uint64_t)1 << t->priority;
+      ready_lists_size++;
+      return;
+    }
+  /* Ensure fifo property when priority is equal */
+  t->ready_treap_fifo = ++thread_ready_treap_fifo;
+#ifdef _MDEBUG
+  ASSERT (t->node.data == t);
+#endif
+  treap_insert (&ready_treap, &t->node);
+}
+
+/* Removes T from the bitmap-indexed ready queue. */
+static void
+ready_lists_remove (struct thread *t)
+{
+  list_remove (&t->elem);
+  if (list_empty (&ready_lists[t->priority]))
+    ready_lists_bitmap &= ~((uint64_t)1 << t->priority);
+  ready_lists_size--;
+}
+
+/* Removes and returns the ready thread with the highest priority.
+   The ready queue must not be empty. */
+static struct thread *
+ready_queue_pop (void)
+{
+  if (thread_ready_bitmap)
+    {
+      /* Find-first-set gives the highest non-empty priority */
+      struct list *l = &ready_lists[ready_lists_highest (ready_lists_bitmap)];
+      struct thread *t = list_entry (list_front (l), struct thread, elem);
+      ready_lists_remove (t);
+      return t;
+    }
+  return (struct thread *)(treap_pop_front (&ready_treap)->data);
+}
+
+/* Returns the number of threads in the ready queue. */
+static int
+ready_queue_size (void)
+{
+  if (thread_ready_bitmap)
+    return ready_lists_size;
+  return treap_size (&ready_treap);
+}
+
+/* Changes the priority of ready thread T to PRIORITY, keeping the
+   ready queue ordered. */
+static void
+ready_queue_priority_update (struct thread *t, int priority)
+{
+  ASSERT (t->status == THREAD_READY);
+
+  if (thread_ready_bitmap)
+    {
+      /* Move between the per-priority lists in O(1) */
+      if (t->priority == priority)
+        return;
+      ready_lists_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+      return;
+    }
+  treap_node_update (&t->node, thread_treap_node_priority_update,
+                     (void *)&priority);
+}
+
 /* Completes a thread switch by activating the new thread's page
    tables, and, if the previous thread is dying, destroying it.
 
@@ -655,14 +781,18 @@ allocate_tid (void)
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
-void
-thread_unblock_check (struct thread *th, void *ticks)
+/* Treap node cmp function according to thread wake up tick */
+bool
+thread_sleep_treap_cmp (const struct treap_node *a,
+                        const struct treap_node *b)
 {
-  if (th->status == THREAD_BLOCKED && th->ticks_to_unblock == *(int *)ticks)
-    {
-      th->ticks_to_unblock = THREAD_TICKS_TO_UNBLOCK_NO_TICKS;
-      thread_unblock (th);
-    }
+  const struct thread *th_a = (const struct thread *)a->data;
+  const struct thread *th_b = (const struct thread *)b->data;
+  /* Earlier wake up tick first */
+  if (th_a->ticks_to_unblock != th_b->ticks_to_unblock)
+    return th_a->ticks_to_unblock < th_b->ticks_to_unblock;
+  /* Just make two different threads are different */
+  return th_a->tid < th_b->tid;
 }
 
 /* mlfqs */
@@ -683,16 +813,15 @@ void
 thread_calc_load_avg ()
 {
   /* load_avg = (59/60) * load_avg + (1/60) * ready_threads */
-  int ready_threads = treap_size (&ready_treap) + (thread_current () != idle_thread);
+  int ready_threads = ready_queue_size () + (thread_current () != idle_thread);
   load_avg = fp32_mul (fp32_div (int_to_fp32 (59), int_to_fp32 (60)), load_avg)
              + fp32_mul_int (fp32_div_int (int_to_fp32 (1), 60), ready_threads);
 }
 
-void
-thread_calc_priority (struct thread *th)
+/* Returns the mlfqs priority of TH from its recent_cpu and nice */
+static int
+thread_mlfqs_priority (struct thread *th)
 {
-  if (th == idle_thread)
-    return;
   /* priotiry = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
   int priority
       = PRI_MAX - fp32_to_int (fp32_div_int (th->recent_cpu, 4)) - th->nice * 2;
@@ -700,10 +829,19 @@ thread_calc_priority (struct thread *th)
     priority = PRI_MAX;
   if (priority < PRI_MIN)
     priority = PRI_MIN;
+  return priority;
+}
+
+void
+thread_calc_priority (struct thread *th)
+{
+  if (th == idle_thread)
+    return;
+  int priority = thread_mlfqs_priority (th);
 
   if (th->status == THREAD_READY)
     {
-      treap_node_update (&th->node, thread_treap_node_priority_update, (void *)&priority);
+      ready_queue_priority_update (th, priority);
     }
   else if (th->status == THREAD_BLOCKED)
     {
@@ -745,25 +883,6 @@ thread_priority_treap_cmp (const struct treap_node *a,
   return th_a->ready_treap_fifo < th_b->ready_treap_fifo;
 }
 
-/* Apply lock hold event for a thread */
-void
-thread_hold_lock (struct lock *lock)
-{
-  /* Ensure no interruption */
-  enum intr_level old_level = intr_disable ();
-  struct thread *cur = thread_current ();
-  /* Maintain holding locks treap */
-  treap_insert (&cur->holding_locks, &lock->node);
-  /* Distribute lock's donated priority to holding thread */
-  if (lock->max_priority > cur->priority)
-    {
-      cur->priority = lock->max_priority;
-      thread_yield ();
-    }
-  /* Recore intr level */
-  intr_set_level (old_level);
-}
-
 /* Apply lock release event for a thread */
 void
 thread_release_lock (struct lock *lock)
@@ -800,8 +919,7 @@ thread_update_priority (struct thread *th)
   /* We need to do update when threads in ready treap or lock blocking treap */
   if (th->status == THREAD_READY)
     {
-      treap_node_update (&th->node, thread_treap_node_priority_update,
-                         (void *)&max_priority);
+      ready_queue_priority_update (th, max_priority);
     }
   else if (th->status == THREAD_BLOCKED)
     {
@@ -822,4 +940,89 @@ void
 thread_treap_node_priority_update (struct treap_node *node, void *max_priority)
 {
   ((struct thread *)node->data)->priority = *(int *)max_priority;
-}
\ No newline at end of file
+}
+
+/* fp32 power with non-negative int exponent, by squaring */
+static fp32_t
+fp32_pow_int (fp32_t x, int32_t n)
+{
+  fp32_t ret = int_to_fp32 (1);
+  for (; n > 0; n >>= 1)
+    {
+      if (n & 1)
+        ret = fp32_mul (ret, x);
+      x = fp32_mul (x, x);
+    }
+  return ret;
+}
+
+/* Applies to TH's recent_cpu the decays of every epoch since it was
+   last brought up to date.  Epochs older than the decay table are
+   approximated with the oldest factor still known, in closed form:
+   m decays with factor c give c^m * recent_cpu + nice * (1-c^m)/(1-c). */
+static void
+thread_catch_up_recent_cpu (struct thread *th)
+{
+  int lag = mlfqs_epoch - th->recent_cpu_epoch;
+  if (lag > MLFQS_DECAY_TABLE_SIZE)
+    {
+      int m = lag - MLFQS_DECAY_TABLE_SIZE;
+      fp32_t c = mlfqs_decay_table[(mlfqs_epoch + 1) % MLFQS_DECAY_TABLE_SIZE];
+      fp32_t c_m = fp32_pow_int (c, m);
+      th->recent_cpu = fp32_mul (c_m, th->recent_cpu)
+                       + fp32_mul_int (fp32_div (int_to_fp32 (1) - c_m,
+                                                 int_to_fp32 (1) - c),
+                                       th->nice);
+      th->recent_cpu_epoch += m;
+    }
+  /* The remaining epochs are all in the table, apply them exactly */
+  while (th->recent_cpu_epoch != mlfqs_epoch)
+    {
+      th->recent_cpu_epoch++;
+      th->recent_cpu
+          = fp32_mul (mlfqs_decay_table[th->recent_cpu_epoch
+                                        % MLFQS_DECAY_TABLE_SIZE],
+                      th->recent_cpu)
+            + int_to_fp32 (th->nice);
+    }
+}
+
+/* Starts a new recent_cpu decay epoch, lazy counterpart of
+   thread_foreach (thread_calc_recent_cpu, NULL).  Only the running
+   and ready threads are decayed now, since their priorities order the
+   ready queue; blocked threads catch up in thread_unblock().  So the
+   work no longer grows with the number of blocked threads. */
+void
+thread_decay_recent_cpu_lazy (void)
+{
+  ASSERT (thread_mlfqs_lazy);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Precompute this epoch's decay factor once for all threads */
+  fp32_t load_avg_mul_2 = fp32_mul_int (load_avg, 2);
+  mlfqs_epoch++;
+  mlfqs_decay_table[mlfqs_epoch % MLFQS_DECAY_TABLE_SIZE]
+      = fp32_div (load_avg_mul_2, load_avg_mul_2 + int_to_fp32 (1));
+
+  struct thread *cur = thread_current ();
+  if (cur != idle_thread)
+    {
+      thread_catch_up_recent_cpu (cur);
+      cur->priority = thread_mlfqs_priority (cur);
+    }
+
+  /* Drain the ready queue, in order, to re-queue it with new priorities.
+     Threads of equal priority keep their relative order. */
+  struct list ready;
+  list_init (&ready);
+  while (ready_queue_size ())
+    list_push_back (&ready, &ready_queue_pop ()->elem);
+  while (!list_empty (&ready))
+    {
+      struct thread *t
+          = list_entry (list_pop_front (&ready), struct thread, elem);
+      thread_catch_up_recent_cpu (t);
+      t->priority = thread_mlfqs_priority (t);
+      ready_queue_push (t);
+    }
+}
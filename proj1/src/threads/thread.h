@@ -103,9 +103,11 @@ struct thread
   struct treap holding_locks; /* Locks this thread hold */
   struct lock *waiting_lock;  /* The lock this thread is blocked from */
 
-  int64_t ticks_to_unblock;
+  int64_t ticks_to_unblock;    /* Tick to wake up from timer_sleep() */
+  struct treap_node sleep_node; /* Treap element for the sleep treap */
   int nice; /* nice value of the thread, -20 to 20 */
   fp32_t recent_cpu;
+  int recent_cpu_epoch; /* Last decay epoch applied to recent_cpu */
 
 #ifdef USERPROG
   /* Owned by userprog/process.c. */
@@ -121,6 +123,17 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If false (default), decay every thread's recent_cpu each second.
+   If true, decay only running and ready threads each second and let
+   blocked threads catch up when they are unblocked.
+   Controlled by kernel command-line option "-mlfqs-lazy". */
+extern bool thread_mlfqs_lazy;
+
+/* If false (default), keep ready threads in a treap.
+   If true, use the bitmap-indexed multi-level ready queue.
+   Controlled by kernel command-line option "-rqbitmap". */
+extern bool thread_ready_bitmap;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -152,20 +165,21 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-void thread_unblock_check (struct thread *th, void *ticks);
+/* Treap node cmp function according to thread wake up tick */
+bool thread_sleep_treap_cmp (const struct treap_node *a,
+                             const struct treap_node *b);
 
 /* mlfqs */
 void thread_calc_load_avg ();
 void thread_increase_recent_cpu ();
 void thread_calc_priority (struct thread *th);
 void thread_calc_recent_cpu (struct thread *th, void *aux UNUSED);
+void thread_decay_recent_cpu_lazy (void);
 
 /* Priority functions */
 /* Treap node cmp function according to thread priority */
 bool thread_priority_treap_cmp (const struct treap_node *a,
                                 const struct treap_node *b);
-/* Apply lock hold event for a thread */
-void thread_hold_lock (struct lock *);
 /* Apply lock release event for a thread */
 void thread_release_lock (struct lock *);
 /* Update the given thread's priority according to holding locks */
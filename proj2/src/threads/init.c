@@ -26,6 +26,7 @@
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
@@ -98,6 +99,9 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+#ifdef USERPROG
+  pagedir_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
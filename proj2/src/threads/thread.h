@@ -84,6 +84,8 @@ typedef int tid_t;
    only because they are mutually exclusive: only a thread in the
    ready state is on the run queue, whereas only a thread in the
    blocked state is on a semaphore wait list. */
+struct file_list_elem;
+
 struct thread
 {
   /* Owned by thread.c. */
@@ -106,8 +108,9 @@ struct thread
   struct thread *parent;   /* Parent process */
   struct process *process; /* Process info */
   struct file *self_file;  /* File for process self */
-  struct list open_files;  /* List of opened files under current thread */
-  int fd;                  /* Counter to set correct file descriptor */
+  struct file_list_elem **fd_table; /* Opened files indexed by fd */
+  int fd_table_size;                /* Number of slots in fd_table */
+  int fd_min_free;                  /* No free fd below this one */
 #endif
 
   /* Owned by thread.c. */
@@ -2,12 +2,58 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include <hash.h>
 #include "threads/init.h"
+#include "threads/malloc.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+
+/* PTE bit available for OS use, set on a page that is writable but
+   shares its frame copy-on-write.  Its PTE stays read-only until
+   pagedir_unshare_page(). */
+#define PTE_COW 0x200
+
+/* A user frame mapped by more than one page directory. */
+struct shared_frame
+  {
+    struct hash_elem elem;      /* Element in shared_frames. */
+    void *kpage;                /* Kernel virtual address of frame. */
+    unsigned refs;              /* Number of page directories. */
+  };
+
+/* Frames shared by pagedir_share_page(), keyed by KPAGE. */
+static struct hash shared_frames;
+static struct lock shared_frames_lock;
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void release_frame (void *kpage);
+
+static unsigned
+shared_frame_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct shared_frame *sf = hash_entry (e, struct shared_frame, elem);
+  return hash_bytes (&sf->kpage, sizeof sf->kpage);
+}
+
+static bool
+shared_frame_less (const struct hash_elem *a, const struct hash_elem *b,
+                   void *aux UNUSED)
+{
+  return hash_entry (a, struct shared_frame, elem)->kpage
+         < hash_entry (b, struct shared_frame, elem)->kpage;
+}
+
+/* Initializes the table of shared frames. */
+void
+pagedir_init (void)
+{
+  if (!hash_init (&shared_frames, shared_frame_hash, shared_frame_less,
+                  NULL))
+    PANIC ("Not enough memory for shared frame table.");
+  lock_init (&shared_frames_lock);
+}
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -41,12 +87,46 @@ pagedir_destroy (uint32_t *pd)
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
           if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
+            release_frame (pte_get_page (*pte));
         palloc_free_page (pt);
       }
   palloc_free_page (pd);
 }
 
+/* Creates a new page directory that maps the same user pages as
+   PD, sharing their frames copy-on-write.
+   Returns the new page directory, or a null pointer if memory
+   allocation fails. */
+uint32_t *
+pagedir_fork (uint32_t *pd) 
+{
+  uint32_t *child = pagedir_create ();
+  uint32_t *pde;
+
+  if (child == NULL)
+    return NULL;
+
+  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
+    if (*pde & PTE_P) 
+      {
+        uint32_t *pt = pde_get_pt (*pde);
+        uint32_t *pte;
+
+        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
+          if (*pte & PTE_P) 
+            {
+              void *upage = (void *) (((pde - pd) << PDSHIFT)
+                                      | ((pte - pt) << PTSHIFT));
+              if (!pagedir_share_page (pd, child, upage))
+                {
+                  pagedir_destroy (child);
+                  return NULL;
+                }
+            }
+      }
+  return child;
+}
+
 /* Returns the address of the page table entry for virtual
    address VADDR in page directory PD.
    If PD does not have a page table for VADDR, behavior depends
@@ -156,6 +236,152 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Returns the shared_frames entry of KPAGE, or a null pointer if
+   only one page directory maps it.
+   shared_frames_lock must be held. */
+static struct shared_frame *
+shared_frame_find (void *kpage) 
+{
+  struct shared_frame key;
+  struct hash_elem *e;
+
+  key.kpage = kpage;
+  e = hash_find (&shared_frames, &key.elem);
+  return e != NULL ? hash_entry (e, struct shared_frame, elem) : NULL;
+}
+
+/* Drops one page directory's reference to user frame KPAGE,
+   freeing the frame unless other page directories still map
+   it. */
+static void
+release_frame (void *kpage) 
+{
+  struct shared_frame *sf;
+
+  lock_acquire (&shared_frames_lock);
+  sf = shared_frame_find (kpage);
+  if (sf != NULL && --sf->refs == 1)
+    {
+      hash_delete (&shared_frames, &sf->elem);
+      free (sf);
+    }
+  lock_release (&shared_frames_lock);
+  if (sf == NULL)
+    palloc_free_page (kpage);
+}
+
+/* Maps user virtual page UPAGE in page directory CHILD to the
+   frame UPAGE is mapped to in PD, which must be present.  UPAGE
+   must not already be mapped in CHILD.
+   If the page is writable, its frame is shared copy-on-write:
+   both PTEs become read-only until pagedir_unshare_page().
+   The dirty bit is shared too, so that either process can tell
+   the frame differs from the page's backing store.
+   Returns true if successful, false if memory allocation
+   failed. */
+bool
+pagedir_share_page (uint32_t *pd, uint32_t *child, void *upage) 
+{
+  uint32_t *pte, *child_pte;
+  struct shared_frame *sf;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  pte = lookup_page (pd, upage, false);
+  ASSERT (pte != NULL && (*pte & PTE_P) != 0);
+  child_pte = lookup_page (child, upage, true);
+  if (child_pte == NULL)
+    return false;
+  ASSERT ((*child_pte & PTE_P) == 0);
+
+  lock_acquire (&shared_frames_lock);
+  sf = shared_frame_find (pte_get_page (*pte));
+  if (sf == NULL)
+    {
+      sf = malloc (sizeof *sf);
+      if (sf == NULL)
+        {
+          lock_release (&shared_frames_lock);
+          return false;
+        }
+      sf->kpage = pte_get_page (*pte);
+      sf->refs = 1;
+      hash_insert (&shared_frames, &sf->elem);
+    }
+  sf->refs++;
+  if (*pte & PTE_W)
+    *pte = (*pte & ~(uint32_t) PTE_W) | PTE_COW;
+  *child_pte = *pte;
+  lock_release (&shared_frames_lock);
+
+  invalidate_pagedir (pd);
+  return true;
+}
+
+/* Makes copy-on-write page UPAGE in PD writable again.  If other
+   page directories still share its frame, the page is first
+   copied into KPAGE, a page obtained from the user pool, and
+   remapped there.
+   Returns true if KPAGE now holds the page.  Returns false,
+   leaving KPAGE alone, if UPAGE kept its frame because no other
+   page directory maps it any more, or if UPAGE is not a present
+   copy-on-write page. */
+bool
+pagedir_unshare_page (uint32_t *pd, void *upage, void *kpage) 
+{
+  uint32_t *pte;
+  struct shared_frame *sf;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (pg_ofs (kpage) == 0);
+
+  pte = lookup_page (pd, upage, false);
+  if (pte == NULL || (*pte & (PTE_P | PTE_COW)) != (PTE_P | PTE_COW))
+    return false;
+
+  lock_acquire (&shared_frames_lock);
+  sf = shared_frame_find (pte_get_page (*pte));
+  if (sf != NULL)
+    {
+      memcpy (kpage, pte_get_page (*pte), PGSIZE);
+      if (--sf->refs == 1)
+        {
+          hash_delete (&shared_frames, &sf->elem);
+          free (sf);
+        }
+      *pte = vtop (kpage) | (*pte & PGMASK);
+    }
+  *pte = (*pte & ~(uint32_t) PTE_COW) | PTE_W;
+  lock_release (&shared_frames_lock);
+
+  invalidate_pagedir (pd);
+  return sf != NULL;
+}
+
+/* Returns true if the PTE for virtual page VPAGE in PD is
+   copy-on-write, that is, if writes to it fault until
+   pagedir_unshare_page(). */
+bool
+pagedir_is_cow (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_COW)) == (PTE_P | PTE_COW);
+}
+
+/* Returns true if user frame KPAGE is mapped by more than one
+   page directory. */
+bool
+pagedir_is_shared (void *kpage) 
+{
+  bool shared;
+
+  lock_acquire (&shared_frames_lock);
+  shared = shared_frame_find (kpage) != NULL;
+  lock_release (&shared_frames_lock);
+  return shared;
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -4,11 +4,17 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+void pagedir_init (void);
 uint32_t *pagedir_create (void);
+uint32_t *pagedir_fork (uint32_t *pd);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
 void pagedir_clear_page (uint32_t *pd, void *upage);
+bool pagedir_share_page (uint32_t *pd, uint32_t *child, void *upage);
+bool pagedir_unshare_page (uint32_t *pd, void *upage, void *kpage);
+bool pagedir_is_cow (uint32_t *pd, const void *vpage);
+bool pagedir_is_shared (void *kpage);
 bool pagedir_is_dirty (uint32_t *pd, const void *upage);
 void pagedir_set_dirty (uint32_t *pd, const void *upage, bool dirty);
 bool pagedir_is_accessed (uint32_t *pd, const void *upage);
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -42,6 +43,11 @@ static bool deny_write_to_self (struct thread *cur, const char *name);
 static void recover_write_to_self (struct thread *cur);
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
+/* Deny write to self file, the one PARENT runs */
+static bool inherit_self_file (struct thread *cur, struct thread *parent);
+/* Copy the address space of PARENT into the current thread */
+static bool fork_address_space (struct thread *parent);
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -85,19 +91,22 @@ process_execute (const char *file_name)
   /* Free the allocated page */
   palloc_free_page (exact_file_name);
 
-  /* Thread create success */
-  if (tid != TID_ERROR)
-    {
-      /* Get the child process */
-      struct thread *child = get_thread (tid);
-      ASSERT (child);
-      ASSERT (child->parent);
-      /* Insert child into parent's list */
-      list_push_back (&child->parent->child_list, &child->process->elem);
-    }
   return tid;
 }
 
+/* Starts a new thread running a copy of the current user process,
+   which made a system call with interrupt frame F.  The copy shares
+   the memory of the process copy-on-write and returns 0 from the
+   system call.  The new thread may be scheduled (and may even exit)
+   before process_fork() returns, F must stay valid until it has
+   upped its load sema.  Returns the new process's thread id, or
+   TID_ERROR if the thread cannot be created. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  return thread_create (thread_name (), PRI_DEFAULT, start_fork, f);
+}
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
@@ -169,6 +178,33 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/* A thread function that copies the user process of its parent,
+   which waits in syscall_fork() meanwhile, and starts it running. */
+static void
+start_fork (void *f_)
+{
+  struct thread *cur = thread_current ();
+  struct thread *parent = cur->parent;
+  /* Copy the frame of the parent before it goes on */
+  struct intr_frame if_ = *(struct intr_frame *)f_;
+  /* The child returns 0 from fork () */
+  if_.eax = 0;
+
+  bool success = inherit_self_file (cur, parent)
+                 && fork_address_space (parent) && fd_table_copy (parent);
+  /* Set the status, the same as after loading */
+  cur->process->status = success ? PROCESS_RUNNING : PROCESS_ERROR;
+  /* Copying has been finished, sema up the load sema */
+  sema_up (&cur->process->load_sema);
+  /* Quit if copying failed */
+  if (!success)
+    thread_exit ();
+
+  /* Start the user process, see start_process () */
+  asm volatile("movl %0, %%esp; jmp intr_exit" : : "g"(&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -666,6 +702,23 @@ deny_write_to_self (struct thread *cur, const char *name)
   return true;
 }
 
+/* Deny write to self file, the one PARENT runs */
+static bool
+inherit_self_file (struct thread *cur, struct thread *parent)
+{
+  /* Parent may have no self file, if it failed to load */
+  if (!parent->self_file)
+    return true;
+  /* Open self file again */
+  cur->self_file = file_reopen (parent->self_file);
+  /* Open failed */
+  if (!cur->self_file)
+    return false;
+  /* Deny write */
+  file_deny_write (cur->self_file);
+  return true;
+}
+
 /* Recover the deny for writing to self */
 static void
 recover_write_to_self (struct thread *cur)
@@ -681,6 +734,19 @@ recover_write_to_self (struct thread *cur)
     }
 }
 
+/* Copy the address space of PARENT into the current thread */
+static bool
+fork_address_space (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  /* Share all the pages of parent copy-on-write */
+  cur->pagedir = pagedir_fork (parent->pagedir);
+  if (!cur->pagedir)
+    return false;
+  process_activate ();
+  return true;
+}
+
 /* Init process infos that are maintained in thread */
 void
 process_thread_init (struct thread *th)
@@ -688,8 +754,9 @@ process_thread_init (struct thread *th)
   th->parent = NULL;
   th->process = NULL;
   list_init (&th->child_list);
-  list_init (&th->open_files);
-  th->fd = 2; /* Reserved for stdin and stdout */
+  th->fd_table = NULL;
+  th->fd_table_size = 0;
+  th->fd_min_free = 2; /* Reserved for stdin and stdout */
   th->self_file = NULL;
 }
 
@@ -4,7 +4,10 @@
 #include "threads/thread.h"
 #include "threads/synch.h"
 
+struct intr_frame;
+
 tid_t process_execute (const char *file_name);
+tid_t process_fork (struct intr_frame *f);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
@@ -1,12 +1,27 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 #include <stdbool.h>
+#include <stddef.h>
+
+struct intr_frame;
+struct thread;
+
+/* A buffer of readv () and writev () */
+struct iovec
+{
+  void *iov_base; /* Start of the buffer */
+  size_t iov_len; /* Its size in bytes */
+};
+
+/* Max number of buffers of readv () and writev () */
+#define IOV_MAX 1024
 
 void syscall_init (void);
 
 void syscall_halt (void);
 void syscall_exit (int status);
 int syscall_exec (const char *cmd_line);
+int syscall_fork (struct intr_frame *f);
 int syscall_wait (int pid);
 bool syscall_create (const char *file, unsigned initial_size);
 bool syscall_remove (const char *file);
@@ -17,5 +32,14 @@ int syscall_write (int fd, const void *buffer, unsigned size);
 void syscall_seek (int fd, unsigned position);
 unsigned syscall_tell (int fd);
 void syscall_close (int fd);
+int syscall_pread (int fd, void *buffer, unsigned size, unsigned offset);
+int syscall_pwrite (int fd, const void *buffer, unsigned size,
+                    unsigned offset);
+int syscall_readv (int fd, const struct iovec *iov, int iovcnt);
+int syscall_writev (int fd, const struct iovec *iov, int iovcnt);
+
+/* Copy the open files of PARENT to the same fds of the current thread,
+   each with a position of its own.  False if out of memory */
+bool fd_table_copy (const struct thread *parent);
 
 #endif /* userprog/syscall.h */
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+fork-cow: exit(81)
+(fork-cow) wait(fork()) = 81
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
@@ -0,0 +1,21 @@
+/* Forks a child.  fork() must return 0 in the child and the
+   child's pid in the parent, which wait() then takes. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t pid = fork ();
+
+  if (pid == 0)
+    {
+      msg ("child run");
+      exit (81);
+    }
+  if (pid < 0)
+    fail ("fork() returned %d", pid);
+  msg ("wait(fork()) = %d", wait (pid));
+}
@@ -0,0 +1,16 @@
+/* Passes an invalid buffer pointer to the pread system call.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int handle;
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  pread (handle, (char *) 0xc0100000, 123, 0);
+  fail ("should not have survived pread()");
+}
@@ -0,0 +1,35 @@
+/* Writes and reads a file with pwrite() and pread(), which must
+   not move the file position that tell(), read() and write()
+   use. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  int size = sizeof sample - 1;
+  int handle;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  seek (handle, 10);
+
+  CHECK (pwrite (handle, sample, size, 0) == size, "pwrite \"test.txt\"");
+  if (tell (handle) != 10)
+    fail ("tell() returned %u after pwrite(), not 10", tell (handle));
+
+  CHECK (pread (handle, buf, 20, 30) == 20, "pread 20 bytes at 30");
+  if (memcmp (buf, sample + 30, 20))
+    fail ("pread() read wrong data");
+  if (tell (handle) != 10)
+    fail ("tell() returned %u after pread(), not 10", tell (handle));
+
+  CHECK (read (handle, buf, 5) == 5, "read 5 bytes");
+  if (memcmp (buf, sample + 10, 5))
+    fail ("read() did not start where seek() left the position");
+}
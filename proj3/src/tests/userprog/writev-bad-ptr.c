@@ -0,0 +1,18 @@
+/* Passes an iovec with an invalid buffer pointer to the writev
+   system call.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct iovec iov = {(void *) 0xc0100000, 123};
+  int handle;
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  writev (handle, &iov, 1);
+  fail ("should not have survived writev()");
+}
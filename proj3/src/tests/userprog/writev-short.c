@@ -0,0 +1,29 @@
+/* Writes three buffers with writev() to a 10-byte file, which
+   does not grow, so writev() must stop at the buffer the end of
+   file cuts short. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct iovec iov[3] = {{sample, 6}, {sample + 6, 20}, {sample + 26, 5}};
+  char buf[10];
+  int handle;
+
+  CHECK (create ("test.txt", sizeof buf), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  CHECK (writev (handle, iov, 3) == sizeof buf, "writev 10 bytes");
+  if (tell (handle) != sizeof buf)
+    fail ("tell() returned %u after writev(), not 10", tell (handle));
+
+  CHECK (pread (handle, buf, sizeof buf, 0) == sizeof buf,
+         "pread 10 bytes at 0");
+  if (memcmp (buf, sample, sizeof buf))
+    fail ("writev() wrote wrong data");
+}
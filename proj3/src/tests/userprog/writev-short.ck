@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(writev-short) begin
+(writev-short) create "test.txt"
+(writev-short) open "test.txt"
+(writev-short) writev 10 bytes
+(writev-short) pread 10 bytes at 0
+(writev-short) end
+writev-short: exit(0)
+EOF
+pass;
@@ -26,6 +26,7 @@
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
@@ -102,6 +103,9 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+#ifdef USERPROG
+  pagedir_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -270,6 +274,22 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-pl"))
+        frame_pager_low = atoi (value);
+      else if (!strcmp (name, "-ph"))
+        frame_pager_high = atoi (value);
+      else if (!strcmp (name, "-evict"))
+        {
+          if (value != NULL && !strcmp (value, "lru"))
+            frame_evict_policy = FRAME_EVICT_LRU;
+          else if (value != NULL && !strcmp (value, "clock"))
+            frame_evict_policy = FRAME_EVICT_CLOCK;
+          else
+            PANIC ("unknown eviction policy `%s' (use lru or clock)",
+                   value != NULL ? value : "");
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -392,6 +412,11 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -pl=COUNT          Clean frames in background below COUNT free.\n"
+          "  -ph=COUNT          Stop cleaning frames at COUNT free.\n"
+          "  -evict=POLICY      Evict frames by POLICY, lru or clock.\n"
 #endif
           );
   shutdown_power_off ();
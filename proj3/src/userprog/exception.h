@@ -1,6 +1,9 @@
 #ifndef USERPROG_EXCEPTION_H
 #define USERPROG_EXCEPTION_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 /* Page fault error code bits that describe the cause of the exception.  */
 #define PF_P 0x1    /* 0: not-present page. 1: access rights violation. */
 #define PF_W 0x2    /* 0: read, 1: write. */
@@ -9,4 +12,11 @@
 void exception_init (void);
 void exception_print_stats (void);
 
+/* Copies between kernel memory and user memory at addresses a user
+   process supplied.  A bad user address makes them fail, through
+   the page fault handler, instead of faulting the kernel. */
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+int strncpy_from_user (char *dst, const char *usrc, size_t size);
+
 #endif /* userprog/exception.h */
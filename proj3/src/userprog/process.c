@@ -50,6 +50,11 @@ static void process_remove_all_frames (tid_t tid);
 static void process_free_mmap_list (struct thread *cur);
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
+/* Deny write to self file, the one PARENT runs */
+static bool inherit_self_file (struct thread *cur, struct thread *parent);
+/* Copy the address space of PARENT into the current thread */
+static bool fork_address_space (struct thread *parent);
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -93,19 +98,22 @@ process_execute (const char *file_name)
   /* Free the allocated page */
   palloc_free_page (exact_file_name);
 
-  /* Thread create success */
-  if (tid != TID_ERROR)
-    {
-      /* Get the child process */
-      struct thread *child = get_thread (tid);
-      ASSERT (child);
-      ASSERT (child->parent);
-      /* Insert child into parent's list */
-      list_push_back (&child->parent->child_list, &child->process->elem);
-    }
   return tid;
 }
 
+/* Starts a new thread running a copy of the current user process,
+   which made a system call with interrupt frame F.  The copy shares
+   the memory of the process copy-on-write and returns 0 from the
+   system call.  The new thread may be scheduled (and may even exit)
+   before process_fork() returns, F must stay valid until it has
+   upped its load sema.  Returns the new process's thread id, or
+   TID_ERROR if the thread cannot be created. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  return thread_create (thread_name (), PRI_DEFAULT, start_fork, f);
+}
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
@@ -177,6 +185,33 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/* A thread function that copies the user process of its parent,
+   which waits in syscall_fork() meanwhile, and starts it running. */
+static void
+start_fork (void *f_)
+{
+  struct thread *cur = thread_current ();
+  struct thread *parent = cur->parent;
+  /* Copy the frame of the parent before it goes on */
+  struct intr_frame if_ = *(struct intr_frame *)f_;
+  /* The child returns 0 from fork () */
+  if_.eax = 0;
+
+  bool success = inherit_self_file (cur, parent)
+                 && fork_address_space (parent) && fd_table_copy (parent);
+  /* Set the status, the same as after loading */
+  cur->process->status = success ? PROCESS_RUNNING : PROCESS_ERROR;
+  /* Copying has been finished, sema up the load sema */
+  sema_up (&cur->process->load_sema);
+  /* Quit if copying failed */
+  if (!success)
+    thread_exit ();
+
+  /* Start the user process, see start_process () */
+  asm volatile("movl %0, %%esp; jmp intr_exit" : : "g"(&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -224,8 +259,10 @@ process_exit (void)
   recover_write_to_self (cur);
   /* Deallocate resouces */
   process_free_mmap_list (cur);
-  sup_table_free (&cur->sup_page_table);
+  /* Frames first, under frame table lock: once out of frame table the
+     pager can not pick them, so nobody looks at the sup table any more */
   process_remove_all_frames (cur->tid);
+  sup_table_free (&cur->sup_page_table);
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -523,22 +560,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory.  It is grown like the other stack pages, so
+   that it has a sup table entry and can be evicted. */
 static bool
 setup_stack (void **esp)
 {
-  uint8_t *kpage;
-  bool success = false;
-
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL)
-    {
-      success = install_page (((uint8_t *)PHYS_BASE) - PGSIZE, kpage, true);
-      if (success)
-        *esp = PHYS_BASE;
-      else
-        palloc_free_page (kpage);
-    }
+  bool success = grow_stack (((uint8_t *)PHYS_BASE) - PGSIZE);
+  if (success)
+    *esp = PHYS_BASE;
   return success;
 }
 
@@ -646,6 +675,23 @@ deny_write_to_self (struct thread *cur, const char *name)
   return true;
 }
 
+/* Deny write to self file, the one PARENT runs */
+static bool
+inherit_self_file (struct thread *cur, struct thread *parent)
+{
+  /* Parent may have no self file, if it failed to load */
+  if (!parent->self_file)
+    return true;
+  /* Open self file again */
+  cur->self_file = file_reopen (parent->self_file);
+  /* Open failed */
+  if (!cur->self_file)
+    return false;
+  /* Deny write */
+  file_deny_write (cur->self_file);
+  return true;
+}
+
 /* Recover the deny for writing to self */
 static void
 recover_write_to_self (struct thread *cur)
@@ -661,6 +707,20 @@ recover_write_to_self (struct thread *cur)
     }
 }
 
+/* Copy the address space of PARENT into the current thread */
+static bool
+fork_address_space (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  /* Allocate and activate page directory */
+  cur->pagedir = pagedir_create ();
+  if (!cur->pagedir)
+    return false;
+  process_activate ();
+  /* Resident pages are shared, the rest copied */
+  return sup_table_fork (parent);
+}
+
 /* Init process infos that are maintained in thread */
 void
 process_thread_init (struct thread *th)
@@ -668,8 +728,9 @@ process_thread_init (struct thread *th)
   th->parent = NULL;
   th->process = NULL;
   list_init (&th->child_list);
-  list_init (&th->open_files);
-  th->fd = 2; /* Reserved for stdin and stdout */
+  th->fd_table = NULL;
+  th->fd_table_size = 0;
+  th->fd_min_free = 2; /* Reserved for stdin and stdout */
   th->self_file = NULL;
 }
 
@@ -711,22 +772,23 @@ get_child_process (struct list *l, pid_t pid)
 static bool
 frame_table_entry_equal_pid (frame_table_entry_t *entry, void *pid)
 {
-  /* If tid of frame table entry matching given tid */
-  return entry->owner == *(tid_t *)pid;
+  /* If the given tid owns or shares the frame */
+  return frame_table_mapped_by (entry, *(tid_t *)pid);
 }
 
 static bool
 do_free_frame_table_entry (frame_table_entry_t *entry)
 {
-  list_remove (&entry->elem);
-  free (entry);
+  /* Called by the exiting process itself */
+  frame_table_leave (entry, thread_tid ());
   return false;
 }
 
 static void
 process_remove_all_frames (tid_t pid)
 {
-  /* Iterate through all table entry and remove them */
+  /* Iterate through all table entry and leave them, a frame shared by
+     fork is handed over to a process still mapping it */
   frame_table_foreach_if (frame_table_entry_equal_pid, &pid,
                           do_free_frame_table_entry);
 }
@@ -1,13 +1,16 @@
 #include "userprog/syscall.h"
+#include "userprog/exception.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "devices/input.h"
 #include "devices/shutdown.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "filesys/filesys.h"
@@ -15,45 +18,43 @@
 #include "vm/frame.h"
 #include "vm/page.h"
 
-/* Lock to protect file system */
-struct lock filesys_lock;
-
 static void syscall_handler (struct intr_frame *);
-/* Check whether the given ptr is valid */
-static void check_valid_ptr (const void *ptr);
-/* Check whether the memeory range is valid between [start, start + size) */
-static void check_valid_mem (const void *start, size_t size);
-/* Check whether the given string is valid */
-static void check_valid_str (const char *str);
+/* Copy the string at user address USTR into a new page */
+static char *copy_in_str (const char *ustr);
 /* Get [argc] args from [f->esp] to [args] with memory checking */
-static void get_args (struct intr_frame *f, void *args[], int argc);
+static void get_args (struct intr_frame *f, uint32_t args[], int argc);
+/* Wait for the new child [pid] to start running, -1 if it failed to */
+static pid_t wait_for_load (pid_t pid);
+/* Close all open files of the current thread and free its fd table */
+static void fd_table_free (void);
 
 struct file_list_elem
 {
   int fd; /* File descriptor */
   struct file *file;
-  struct list_elem elem;
 };
 
-static void *checker_esp;
+/* Slots of a file descriptor table when first allocated */
+#define FD_TABLE_MIN 16
 
 void
 syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  /* Init filesystem lock */
-  lock_init (&filesys_lock);
 }
 
 static void
 syscall_handler (struct intr_frame *f)
 {
+  /* Faults on user memory taken for the process may grow its stack */
+  thread_current ()->user_esp = f->esp;
   /* First need to check whether the address of stack is valid */
-  check_valid_mem (f->esp, sizeof (void *));
-  checker_esp = f->esp;
-  /* The max number of args is 3 */
-  void *args[3];
-  switch (*(int *)f->esp)
+  int nr;
+  if (!copy_from_user (&nr, f->esp, sizeof nr))
+    syscall_exit (-1);
+  /* The max number of args is 4 */
+  uint32_t args[4];
+  switch (nr)
     {
     case SYS_HALT:
       {
@@ -64,99 +65,136 @@ syscall_handler (struct intr_frame *f)
       {
         /* Exit contains 1 argument */
         get_args (f, args, 1);
-        syscall_exit (*(int *)args[0]);
+        syscall_exit ((int)args[0]);
         break;
       }
     case SYS_EXEC:
       {
         /* Exec contains 1 argument */
         get_args (f, args, 1);
-        f->eax = syscall_exec (*(const char **)args[0]);
+        f->eax = syscall_exec ((const char *)args[0]);
+        break;
+      }
+    case SYS_FORK:
+      {
+        /* Fork contains no argument, the child copies the whole frame */
+        f->eax = syscall_fork (f);
         break;
       }
     case SYS_WAIT:
       {
         /* Wait contains 1 argument */
         get_args (f, args, 1);
-        f->eax = syscall_wait (*(pid_t *)args[0]);
+        f->eax = syscall_wait ((pid_t)args[0]);
         break;
       }
     case SYS_CREATE:
       {
         /* Create contains 2 arguments */
         get_args (f, args, 2);
-        f->eax
-            = syscall_create (*(const char **)args[0], *(unsigned *)args[1]);
+        f->eax = syscall_create ((const char *)args[0], (unsigned)args[1]);
         break;
       }
     case SYS_REMOVE:
       {
         /* Remove contains 1 argument */
         get_args (f, args, 1);
-        f->eax = syscall_remove (*(const char **)args[0]);
+        f->eax = syscall_remove ((const char *)args[0]);
         break;
       }
     case SYS_OPEN:
       {
         /* Open contains 1 argument */
         get_args (f, args, 1);
-        f->eax = syscall_open (*(const char **)args[0]);
+        f->eax = syscall_open ((const char *)args[0]);
         break;
       }
     case SYS_FILESIZE:
       {
         /* Filesize contains 1 argument */
         get_args (f, args, 1);
-        f->eax = syscall_filesize (*(int *)args[0]);
+        f->eax = syscall_filesize ((int)args[0]);
         break;
       }
     case SYS_READ:
       {
         /* Read contains 3 arguments */
         get_args (f, args, 3);
-        f->eax = syscall_read (*(int *)args[0], *(void **)args[1],
-                               *(unsigned *)args[2]);
+        f->eax = syscall_read ((int)args[0], (void *)args[1],
+                               (unsigned)args[2]);
         break;
       }
     case SYS_WRITE:
       {
         /* Write contains 3 arguments */
         get_args (f, args, 3);
-        f->eax = syscall_write (*(int *)args[0], *(const void **)args[1],
-                                *(unsigned *)args[2]);
+        f->eax = syscall_write ((int)args[0], (const void *)args[1],
+                                (unsigned)args[2]);
         break;
       }
     case SYS_SEEK:
       {
         /* Seek contains 2 arguments */
         get_args (f, args, 2);
-        syscall_seek (*(int *)args[0], *(unsigned *)args[1]);
+        syscall_seek ((int)args[0], (unsigned)args[1]);
         break;
       }
     case SYS_TELL:
       {
         /* Tell contains 1 argument */
         get_args (f, args, 1);
-        f->eax = syscall_tell (*(int *)args[0]);
+        f->eax = syscall_tell ((int)args[0]);
         break;
       }
     case SYS_CLOSE:
       {
         /* Close contains 1 argument */
         get_args (f, args, 1);
-        syscall_close (*(int *)args[0]);
+        syscall_close ((int)args[0]);
         break;
       }
     case SYS_MMAP:
       {
         get_args (f, args, 2);
-        f->eax = syscall_mmap (*(int *)args[0], *(void **)args[1]);
+        f->eax = syscall_mmap ((int)args[0], (void *)args[1]);
         break;
       }
     case SYS_MUNMAP:
       {
         get_args (f, args, 1);
-        syscall_munmap (*(mapid_t *)args[0]);
+        syscall_munmap ((mapid_t)args[0]);
+        break;
+      }
+    case SYS_PREAD:
+      {
+        /* Pread contains 4 arguments */
+        get_args (f, args, 4);
+        f->eax = syscall_pread ((int)args[0], (void *)args[1],
+                                (unsigned)args[2], (unsigned)args[3]);
+        break;
+      }
+    case SYS_PWRITE:
+      {
+        /* Pwrite contains 4 arguments */
+        get_args (f, args, 4);
+        f->eax = syscall_pwrite ((int)args[0], (const void *)args[1],
+                                 (unsigned)args[2], (unsigned)args[3]);
+        break;
+      }
+    case SYS_READV:
+      {
+        /* Readv contains 3 arguments */
+        get_args (f, args, 3);
+        f->eax = syscall_readv ((int)args[0], (const struct iovec *)args[1],
+                                (int)args[2]);
+        break;
+      }
+    case SYS_WRITEV:
+      {
+        /* Writev contains 3 arguments */
+        get_args (f, args, 3);
+        f->eax = syscall_writev ((int)args[0], (const struct iovec *)args[1],
+                                 (int)args[2]);
         break;
       }
     default:
@@ -168,59 +206,36 @@ syscall_handler (struct intr_frame *f)
     }
 }
 
-/* Check whether the given ptr is valid */
-static void
-check_valid_ptr (const void *ptr)
+/* Copy the string at user address USTR into a new page, which the
+   caller must free.  Returns a null pointer if it does not fit in a
+   page or out of memory, kills the process if USTR is bad */
+static char *
+copy_in_str (const char *ustr)
 {
-  /* [ptr] should not be null, should be in user addr and in page */
-  if (!ptr || !is_user_vaddr (ptr) || ptr < (void *)0x08048000)
+  char *str = palloc_get_page (0);
+  if (!str)
+    return NULL;
+  int len = strncpy_from_user (str, ustr, PGSIZE);
+  if (len < 0)
     {
+      palloc_free_page (str);
       syscall_exit (-1);
     }
-  if (!pagedir_get_page (thread_current ()->pagedir, ptr))
-    {
-      if (!try_get_page ((void *)ptr, checker_esp))
-        syscall_exit (-1);
-    }
-}
-
-/* Check whether the memeory range is valid between [start, start + size) */
-static void
-check_valid_mem (const void *start, size_t size)
-{
-  void *last_page = NULL;
-  /* The simplest way: just loop through and check the whole memory area */
-  for (size_t i = 0; i < size; ++i)
+  if (len == PGSIZE)
     {
-      void *cur_page = pg_round_down (start + i);
-      if (cur_page != last_page)
-        check_valid_ptr (last_page = cur_page);
+      palloc_free_page (str);
+      return NULL;
     }
-}
-
-/* Check whether the given string is valid */
-static void
-check_valid_str (const char *str)
-{
-  /* First check the start addr */
-  check_valid_ptr (str);
-  /* Then check the whole addr of the string */
-  while (*str)
-    check_valid_ptr (++str);
+  return str;
 }
 
 /* Get [argc] args from [f->esp] to [args] with memory checking */
 static void
-get_args (struct intr_frame *f, void *args[], int argc)
+get_args (struct intr_frame *f, uint32_t args[], int argc)
 {
-  for (int i = 0; i < argc; ++i)
-    {
-      /* 4 byte for each argument */
-      void *ptr = ((char *)f->esp) + (i + 1) * 4;
-      /* With memory checking */
-      check_valid_mem (ptr, sizeof (void *));
-      args[i] = ptr;
-    }
+  /* 4 byte for each argument, right above the syscall number */
+  if (!copy_from_user (args, (uint32_t *)f->esp + 1, argc * sizeof *args))
+    syscall_exit (-1);
 }
 
 void
@@ -234,12 +249,7 @@ syscall_exit (int status)
 {
   struct thread *cur = thread_current ();
   /* If there are open files, we should close them first */
-  while (!list_empty (&cur->open_files))
-    {
-      struct file_list_elem *f = list_entry (list_back (&cur->open_files),
-                                             struct file_list_elem, elem);
-      syscall_close (f->fd);
-    }
+  fd_table_free ();
   cur->process->exit_code = status;
   thread_exit ();
 }
@@ -247,22 +257,36 @@ syscall_exit (int status)
 pid_t
 syscall_exec (const char *cmd_line)
 {
-  check_valid_str (cmd_line);
-  /* Since start_process in execute will invoke load from file */
-  /* Then need to protect the filesystem */
-  lock_acquire (&filesys_lock);
-  pid_t pid = process_execute (cmd_line);
-  lock_release (&filesys_lock);
+  char *cmd = copy_in_str (cmd_line);
+  if (!cmd)
+    return -1;
+  pid_t pid = process_execute (cmd);
+  palloc_free_page (cmd);
+  return wait_for_load (pid);
+}
+
+pid_t
+syscall_fork (struct intr_frame *f)
+{
+  pid_t pid = process_fork (f);
+  return wait_for_load (pid);
+}
+
+/* Wait for the new child [pid] to start running, -1 if it failed to */
+static pid_t
+wait_for_load (pid_t pid)
+{
   /* -1 for error */
   if (pid == TID_ERROR)
     return -1;
-  struct thread *child = get_thread (pid);
+  /* The child is in the child list since thread_create (), even if it
+     has exited already.  Only child process (the information struct)
+     outlives the thread */
+  struct process *child_process
+      = get_child_process (&thread_current ()->child_list, pid);
   /* -1 for error */
-  if (!child)
+  if (!child_process)
     return -1;
-  /* Note that when child thread exit */
-  /* Only child process (the information struct) alive */
-  struct process *child_process = child->process;
   /* Wait for child loading */
   sema_down (&child_process->load_sema);
   /* Ensure load success */
@@ -293,30 +317,113 @@ syscall_wait (pid_t pid)
 struct file_list_elem *
 get_file (int fd)
 {
-  struct list *open_file_list = &thread_current ()->open_files;
-  /* Loop through current thread's files, and find fd */
-  for (struct list_elem *e = list_begin (open_file_list);
-       e != list_end (open_file_list); e = list_next (e))
-    {
-      struct file_list_elem *f = list_entry (e, struct file_list_elem, elem);
-      if (f->fd == fd)
-        return f;
-    }
+  struct thread *cur = thread_current ();
+  /* The fd indexes the current thread's table */
+  if (fd >= 0 && fd < cur->fd_table_size && cur->fd_table[fd])
+    return cur->fd_table[fd];
   /* When fd not found */
   syscall_exit (-1);
   return NULL;
 }
 
+/* Put F into the lowest free fd of the current thread, growing the
+   table when full.  Return the fd, or -1 if out of memory */
+static int
+fd_alloc (struct file_list_elem *f)
+{
+  struct thread *cur = thread_current ();
+  int fd = cur->fd_min_free;
+  while (fd < cur->fd_table_size && cur->fd_table[fd])
+    ++fd;
+  if (fd >= cur->fd_table_size)
+    {
+      /* Full, double the table.  It starts out NULL while fd_min_free
+         already points past the standard fds */
+      int size = cur->fd_table_size ? cur->fd_table_size * 2 : FD_TABLE_MIN;
+      while (size <= fd)
+        size *= 2;
+      struct file_list_elem **table
+          = realloc (cur->fd_table, size * sizeof *table);
+      if (!table)
+        return -1;
+      memset (table + cur->fd_table_size, 0,
+              (size - cur->fd_table_size) * sizeof *table);
+      cur->fd_table = table;
+      cur->fd_table_size = size;
+    }
+  cur->fd_table[fd] = f;
+  cur->fd_min_free = fd + 1;
+  f->fd = fd;
+  return fd;
+}
+
+/* Free FD of the current thread for the next fd_alloc */
+static void
+fd_free (int fd)
+{
+  struct thread *cur = thread_current ();
+  cur->fd_table[fd] = NULL;
+  if (fd < cur->fd_min_free)
+    cur->fd_min_free = fd;
+}
+
+/* Close all open files of the current thread and free its fd table */
+static void
+fd_table_free (void)
+{
+  struct thread *cur = thread_current ();
+  for (int fd = 0; fd < cur->fd_table_size; ++fd)
+    if (cur->fd_table[fd])
+      syscall_close (fd);
+  free (cur->fd_table);
+  cur->fd_table = NULL;
+  cur->fd_table_size = 0;
+}
+
+bool
+fd_table_copy (const struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  if (!parent->fd_table_size)
+    return true;
+  cur->fd_table = calloc (parent->fd_table_size, sizeof *cur->fd_table);
+  if (!cur->fd_table)
+    return false;
+  cur->fd_table_size = parent->fd_table_size;
+  cur->fd_min_free = parent->fd_min_free;
+  for (int fd = 0; fd < parent->fd_table_size; ++fd)
+    {
+      struct file_list_elem *from = parent->fd_table[fd];
+      if (!from)
+        continue;
+      struct file_list_elem *to = malloc (sizeof (struct file_list_elem));
+      struct file *file = to ? file_reopen (from->file) : NULL;
+      if (!file)
+        {
+          /* Prevent memory leak */
+          free (to);
+          fd_table_free ();
+          return false;
+        }
+      /* Same position, but moving on its own from now on */
+      file_seek (file, file_tell (from->file));
+      to->fd = fd;
+      to->file = file;
+      cur->fd_table[fd] = to;
+    }
+  return true;
+}
+
 bool
 syscall_create (const char *file, unsigned initial_size)
 {
   /* Check if file name is valid */
-  check_valid_str (file);
-  /* Use lock to protect filesystem */
-  lock_acquire (&filesys_lock);
+  char *name = copy_in_str (file);
+  if (!name)
+    return false;
   /* Invoke func provided in filesys */
-  bool success = filesys_create (file, initial_size);
-  lock_release (&filesys_lock);
+  bool success = filesys_create (name, initial_size);
+  palloc_free_page (name);
   return success;
 }
 
@@ -324,36 +431,39 @@ bool
 syscall_remove (const char *file)
 {
   /* Check if file name is valid */
-  check_valid_str (file);
-  /* Use lock to protect filesystem */
-  lock_acquire (&filesys_lock);
+  char *name = copy_in_str (file);
+  if (!name)
+    return false;
   /* Invoke func provided in filesys */
-  bool success = filesys_remove (file);
-  lock_release (&filesys_lock);
+  bool success = filesys_remove (name);
+  palloc_free_page (name);
   return success;
 }
 
 int
 syscall_open (const char *file)
 {
-  check_valid_str (file);
-  /* Use lock to protect filesystem */
-  lock_acquire (&filesys_lock);
-  struct file *f = filesys_open (file);
-  lock_release (&filesys_lock);
+  char *name = copy_in_str (file);
+  if (!name)
+    return -1;
+  struct file *f = filesys_open (name);
+  palloc_free_page (name);
   /* Return if file open failed */
   if (!f)
     return -1;
-  struct thread *cur = thread_current ();
   struct file_list_elem *open_file = malloc (sizeof (struct file_list_elem));
   /* If open failed */
   if (!open_file)
     return -1;
   /* Initialize open file list entry */
-  open_file->fd = cur->fd++;
   open_file->file = f;
-  /* Add this file to the open file list of current thread */
-  list_push_back (&cur->open_files, &open_file->elem);
+  /* Add this file to the fd table of current thread */
+  if (fd_alloc (open_file) < 0)
+    {
+      file_close (f);
+      free (open_file);
+      return -1;
+    }
   return open_file->fd;
 }
 
@@ -361,52 +471,168 @@ int
 syscall_filesize (int fd)
 {
   struct file_list_elem *f = get_file (fd);
-  /* Use lock to protect filesystem */
-  lock_acquire (&filesys_lock);
   int len = file_length (f->file);
-  lock_release (&filesys_lock);
+  return len;
+}
+
+/* Offset of read_to_user and write_from_user for the file position */
+#define AT_FILE_POS ((off_t)-1)
+
+/* Read SIZE bytes of FILE at OFS, or at and past its position if OFS
+   is AT_FILE_POS, into user BUFFER a page at a time, through a kernel
+   page.  Return the bytes read, -1 if out of memory */
+static int
+read_to_user (struct file *file, void *buffer, unsigned size, off_t ofs)
+{
+  uint8_t *page = palloc_get_page (0);
+  if (!page)
+    return -1;
+  unsigned len = 0;
+  while (len < size)
+    {
+      unsigned chunk = size - len < PGSIZE ? size - len : PGSIZE;
+      unsigned read = ofs == AT_FILE_POS
+                          ? file_read (file, page, chunk)
+                          : file_read_at (file, page, chunk, ofs + len);
+      /* Target memory addr should be valid */
+      if (!copy_to_user ((uint8_t *)buffer + len, page, read))
+        {
+          palloc_free_page (page);
+          syscall_exit (-1);
+        }
+      len += read;
+      if (read < chunk)
+        break;
+    }
+  palloc_free_page (page);
+  return len;
+}
+
+/* Write SIZE bytes of user BUFFER to FILE at OFS, or at and past its
+   position if OFS is AT_FILE_POS, or to the console if FILE is null,
+   a page at a time, through a kernel page.  Return the bytes written,
+   -1 if out of memory */
+static int
+write_from_user (struct file *file, const void *buffer, unsigned size,
+                 off_t ofs)
+{
+  uint8_t *page = palloc_get_page (0);
+  if (!page)
+    return -1;
+  unsigned len = 0;
+  while (len < size)
+    {
+      unsigned chunk = size - len < PGSIZE ? size - len : PGSIZE;
+      /* Source mem addr should be valid */
+      if (!copy_from_user (page, (const uint8_t *)buffer + len, chunk))
+        {
+          palloc_free_page (page);
+          syscall_exit (-1);
+        }
+      unsigned written = chunk;
+      if (!file)
+        putbuf ((const char *)page, chunk);
+      else if (ofs == AT_FILE_POS)
+        written = file_write (file, page, chunk);
+      else
+        written = file_write_at (file, page, chunk, ofs + len);
+      len += written;
+      if (written < chunk)
+        break;
+    }
+  palloc_free_page (page);
   return len;
 }
 
 int
 syscall_read (int fd, void *buffer, unsigned size)
 {
-  /* Target memory addr should be valid */
-  check_valid_mem (buffer, size);
   if (fd == STDIN_FILENO)
     return input_getc ();
   /* Cannot read from std out */
   if (fd == STDOUT_FILENO)
     syscall_exit (-1);
   struct file_list_elem *f = get_file (fd);
-  /* Use lock to protect filesystem */
-  lock_acquire (&filesys_lock);
-  /* Read file */
-  int len = file_read (f->file, buffer, size);
-  lock_release (&filesys_lock);
-  return len;
+  return read_to_user (f->file, buffer, size, AT_FILE_POS);
 }
 
 int
 syscall_write (int fd, const void *buffer, unsigned size)
 {
-  /* Source mem addr should be valid */
-  check_valid_mem (buffer, size);
-  if (fd == STDOUT_FILENO)
-    {
-      putbuf ((const char *)buffer, size);
-      return size;
-    }
   /* Cannot write to std in */
   if (fd == STDIN_FILENO)
     syscall_exit (-1);
+  struct file_list_elem *f = fd == STDOUT_FILENO ? NULL : get_file (fd);
+  return write_from_user (f ? f->file : NULL, buffer, size, AT_FILE_POS);
+}
+
+int
+syscall_pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  /* Only files have offsets */
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO || (off_t)offset < 0)
+    return -1;
+  struct file_list_elem *f = get_file (fd);
+  return read_to_user (f->file, buffer, size, offset);
+}
+
+int
+syscall_pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  /* Only files have offsets */
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO || (off_t)offset < 0)
+    return -1;
+  struct file_list_elem *f = get_file (fd);
+  return write_from_user (f->file, buffer, size, offset);
+}
 
+int
+syscall_readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  /* The console is read by read () */
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO || iovcnt < 0
+      || iovcnt > IOV_MAX)
+    return -1;
   struct file_list_elem *f = get_file (fd);
-  /* Use lock to protect filesystem */
-  lock_acquire (&filesys_lock);
-  /* Write file */
-  int len = file_write (f->file, buffer, size);
-  lock_release (&filesys_lock);
+  int len = 0;
+  /* Fill the buffers in order, until the end of file */
+  for (int i = 0; i < iovcnt; ++i)
+    {
+      struct iovec v;
+      if (!copy_from_user (&v, iov + i, sizeof v))
+        syscall_exit (-1);
+      int read = read_to_user (f->file, v.iov_base, v.iov_len, AT_FILE_POS);
+      if (read < 0)
+        return len > 0 ? len : -1;
+      len += read;
+      if ((size_t)read < v.iov_len)
+        break;
+    }
+  return len;
+}
+
+int
+syscall_writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  /* Cannot write to std in */
+  if (fd == STDIN_FILENO || iovcnt < 0 || iovcnt > IOV_MAX)
+    return -1;
+  struct file_list_elem *f = fd == STDOUT_FILENO ? NULL : get_file (fd);
+  int len = 0;
+  /* Write the buffers out in order, until a short write */
+  for (int i = 0; i < iovcnt; ++i)
+    {
+      struct iovec v;
+      if (!copy_from_user (&v, iov + i, sizeof v))
+        syscall_exit (-1);
+      int written = write_from_user (f ? f->file : NULL, v.iov_base,
+                                     v.iov_len, AT_FILE_POS);
+      if (written < 0)
+        return len > 0 ? len : -1;
+      len += written;
+      if ((size_t)written < v.iov_len)
+        break;
+    }
   return len;
 }
 
@@ -414,20 +640,14 @@ void
 syscall_seek (int fd, unsigned position)
 {
   struct file_list_elem *f = get_file (fd);
-  /* Use lock to protect filesystem */
-  lock_acquire (&filesys_lock);
   file_seek (f->file, position);
-  lock_release (&filesys_lock);
 }
 
 unsigned
 syscall_tell (int fd)
 {
   struct file_list_elem *f = get_file (fd);
-  /* Use lock to protect filesystem */
-  lock_acquire (&filesys_lock);
   int pos = file_tell (f->file);
-  lock_release (&filesys_lock);
   return pos;
 }
 
@@ -435,15 +655,8 @@ void
 syscall_close (int fd)
 {
   struct file_list_elem *f = get_file (fd);
-  /* Use lock to protect filesystem */
-  struct thread *cur = thread_current ();
-  bool need_lock = (filesys_lock.holder != cur);
-  if (need_lock)
-    lock_acquire (&filesys_lock);
   file_close (f->file);
-  if (need_lock)
-    lock_release (&filesys_lock);
-  list_remove (&f->elem);
+  fd_free (fd);
   /* Free to ensure no memory leak */
   free (f);
 }
@@ -476,14 +689,11 @@ do_free_mmap_entry (mmap_entry_t *entry)
           = sup_table_find (&cur->sup_page_table, addr);
       if (table_entry)
         {
-          /* If dirty: write back */
+          /* If dirty: write back, at its offset rather than the
+             file position, which the pager may use meanwhile */
           if (pagedir_is_dirty (cur->pagedir, addr))
-            {
-              lock_acquire (&filesys_lock);
-              file_seek (table_entry->file, table_entry->ofs);
-              file_write (table_entry->file, addr, table_entry->read_bytes);
-              lock_release (&filesys_lock);
-            }
+            file_write_at (table_entry->file, addr, table_entry->read_bytes,
+                           table_entry->ofs);
           /* Delete from page table */
           if (pagedir_get_page (cur->pagedir, table_entry->addr))
             {
@@ -497,9 +707,7 @@ do_free_mmap_entry (mmap_entry_t *entry)
       addr += PGSIZE;
     }
 
-  lock_acquire (&filesys_lock);
   file_close (entry->file);
-  lock_release (&filesys_lock);
   free (entry);
 }
 
@@ -532,9 +740,7 @@ syscall_mmap (int fd, void *addr)
   /* No file or has a length of zero bytes */
   if (!f_entry->file || !(file_size = file_length (f_entry->file)))
     return -1;
-  lock_acquire (&filesys_lock);
   struct file *f = file_reopen (f_entry->file);
-  lock_release (&filesys_lock);
   /* Failed to reopen */
   if (!f)
     return -1;
@@ -6,29 +6,58 @@
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "filesys/file.h"
+#include <stdio.h>
 
-extern struct lock filesys_lock;
+/* Page replacement policy, set by kernel command-line option "-evict". */
+enum frame_evict_policy frame_evict_policy = FRAME_EVICT_LRU;
 
-/* Frame table list, store frame table entries */
-static struct list frame_table;
+/* Frame table, one entry per user pool page */
+static frame_table_entry_t *frame_table;
+/* Number of entries in frame table and how many of them are used */
+static size_t frame_cnt;
+static size_t frame_used_cnt;
 /* Avoid race condition when frame table is modified concurrently */
 static struct lock frame_table_lock;
+/* Index of the next frame the clock hand looks at */
+static size_t clock_hand;
 
+/* Pager watermarks, in free frames.  Set by kernel command-line options
+   "-pl" and "-ph", the pager is disabled while the low one is 0. */
+size_t frame_pager_low;
+size_t frame_pager_high;
+/* Up'd to wake the pager thread */
+static struct semaphore pager_wakeup;
+/* Whether the pager is woken and not done yet, guarded by frame table
+   lock */
+static bool pager_awake;
+
+/* Eviction statistics */
+static unsigned long long evict_cnt;      /* Number of frames evicted */
+static unsigned long long evict_scan_cnt; /* Frames examined by evictions */
+static unsigned evict_scan_max;           /* Longest scan of one eviction */
+static unsigned long long pager_clean_cnt; /* Frames freed by the pager */
+static unsigned long long evict_drop_cnt;  /* Clean file pages dropped */
+
+static void pager_thread (void *aux);
+static void pager_wake (void);
+static size_t frame_free_cnt (void);
+
+/* Frame table lock must be held */
 frame_table_entry_t *
 new_frame_table_entry (void *frame_addr, tid_t owner,
                        sup_page_table_entry_t *sup_entry)
 {
-  /* Allocate space for frame table entry */
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  /* The entry sits at the frame's index in user pool */
   frame_table_entry_t *entry
-      = (frame_table_entry_t *)malloc (sizeof (frame_table_entry_t));
-
-  /* If malloc failed */
-  if (!entry)
-    return NULL;
+      = &frame_table[palloc_user_page_idx (frame_addr)];
+  ASSERT (!entry->frame_addr);
+  frame_used_cnt++;
   /* Initialize frame table entry */
   entry->frame_addr = frame_addr;
   entry->owner = owner;
   entry->sup_table_entry = sup_entry;
+  entry->sharers = NULL;
   return entry;
 }
 
@@ -43,50 +72,48 @@ frame_new_page (sup_page_table_entry_t *sup_entry)
   frame_table_entry_t *frame_entry;
   if (!k_page)
     {
+      /* The pager fell behind, if it runs at all */
+      lock_acquire (&frame_table_lock);
+      pager_wake ();
+      lock_release (&frame_table_lock);
       lock_acquire (&sup_entry->lock);
       /* Evict one frame and reuse this frame table entry */
-      frame_entry = evict_one_frame ();
-      /* Set tid and sup table entry */
-      frame_entry->owner = thread_tid ();
-      frame_entry->sup_table_entry = sup_entry;
+      frame_entry = evict_one_frame (sup_entry);
       lock_release (&sup_entry->lock);
       return frame_entry;
     }
-  /* Create a new frame table entry */
-  frame_entry = new_frame_table_entry (k_page, thread_tid (), sup_entry);
-  /* If frame table entry allocation failed */
-  if (!frame_entry)
-    {
-      palloc_free_page (k_page);
-      return NULL;
-    }
+  /* Fill in the frame table entry of the new page */
   lock_acquire (&frame_table_lock);
-  list_push_back (&frame_table, &frame_entry->elem);
+  frame_entry = new_frame_table_entry (k_page, thread_tid (), sup_entry);
+  if (frame_free_cnt () < frame_pager_low)
+    pager_wake ();
   lock_release (&frame_table_lock);
   return frame_entry;
 }
 
-/* Action func used in frame free page */
-static bool
-free_frame_table_entry (frame_table_entry_t *frame_entry)
-{
-  /* Remove frame entry from frame table */
-  list_remove (&frame_entry->elem);
-  /* Free corresponding frame */
-  palloc_free_page (frame_entry->frame_addr);
-  /* Free the space if frame table entry */
-  free (frame_entry);
-  return true;
+/* Find the entry of a frame in O(1), NULL if it is not in frame table */
+frame_table_entry_t *
+frame_table_lookup (void *frame_addr)
+{
+  frame_table_entry_t *entry
+      = &frame_table[palloc_user_page_idx (frame_addr)];
+  return entry->frame_addr ? entry : NULL;
 }
 
 void
 frame_free_page (void *frame_addr)
 {
-  /* Iterate all frame table entry and free corresponding one */
   if (!frame_addr)
     return;
-  frame_table_foreach_if (frame_table_entry_crspd_frame, frame_addr,
-                          free_frame_table_entry);
+  lock_acquire (&frame_table_lock);
+  /* Free the frame if it is in frame table */
+  frame_table_entry_t *frame_entry = frame_table_lookup (frame_addr);
+  if (frame_entry)
+    {
+      frame_table_remove (frame_entry);
+      palloc_free_page (frame_addr);
+    }
+  lock_release (&frame_table_lock);
 }
 
 /* For each element in frame table, do some actions in some conditions */
@@ -95,13 +122,12 @@ frame_table_foreach_if (frame_table_action_cmp if_cmp, void *cmp_val,
                         frame_table_action_func action_func)
 {
   lock_acquire (&frame_table_lock);
-  /* Iterate through frame table and do comparison one by one */
-  for (struct list_elem *e = list_begin (&frame_table), *next;
-       e != list_end (&frame_table); e = next)
+  /* Iterate through used entries and do comparison one by one */
+  for (size_t i = 0; i < frame_cnt; ++i)
     {
-      next = list_next (e);
-      frame_table_entry_t *entry = list_entry (e, frame_table_entry_t, elem);
-      if (if_cmp (entry, cmp_val) && action_func (entry))
+      frame_table_entry_t *entry = &frame_table[i];
+      if (entry->frame_addr && if_cmp (entry, cmp_val)
+          && action_func (entry))
         {
           break;
         }
@@ -109,61 +135,419 @@ frame_table_foreach_if (frame_table_action_cmp if_cmp, void *cmp_val,
   lock_release (&frame_table_lock);
 }
 
-/* Compare entry->frame and frame addr */
+/* Mark ENTRY unused.  The frame itself is not freed.
+   Frame table lock must be held. */
+void
+frame_table_remove (frame_table_entry_t *entry)
+{
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  ASSERT (entry->frame_addr);
+  ASSERT (!entry->sharers);
+  entry->frame_addr = NULL;
+  entry->sup_table_entry = NULL;
+  frame_used_cnt--;
+}
+
+/* Whether thread TID maps the frame of ENTRY, as its owner or as a
+   sharer.  Frame table lock must be held. */
 bool
-frame_table_entry_crspd_frame (frame_table_entry_t *entry, void *frame_addr)
+frame_table_mapped_by (frame_table_entry_t *entry, tid_t tid)
 {
-  return entry->frame_addr == frame_addr;
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  if (entry->owner == tid)
+    return true;
+  for (struct frame_sharer *s = entry->sharers; s; s = s->next)
+    if (s->tid == tid)
+      return true;
+  return false;
+}
+
+/* Take thread TID, which no longer maps the frame of ENTRY, out of it.
+   An owner hands the entry over to the first sharer, so that the frame
+   stays evictable once the others are gone, or marks it unused if
+   nobody shares it.  The frame itself is not freed.  Frame table lock
+   must be held. */
+void
+frame_table_leave (frame_table_entry_t *entry, tid_t tid)
+{
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  struct frame_sharer *s = entry->sharers;
+  if (entry->owner == tid)
+    {
+      if (!s)
+        {
+          frame_table_remove (entry);
+          return;
+        }
+      entry->owner = s->tid;
+      entry->sup_table_entry = s->sup_table_entry;
+      entry->sharers = s->next;
+      free (s);
+      return;
+    }
+  for (struct frame_sharer **p = &entry->sharers; *p; p = &(*p)->next)
+    if ((*p)->tid == tid)
+      {
+        s = *p;
+        *p = s->next;
+        free (s);
+        return;
+      }
 }
 
 /* Init frame table */
 void
 frame_table_init ()
 {
-  list_init (&frame_table);
+  frame_cnt = palloc_user_page_cnt ();
+  frame_table = calloc (frame_cnt, sizeof *frame_table);
+  if (!frame_table && frame_cnt)
+    PANIC ("Not enough memory for frame table.");
+  frame_used_cnt = 0;
   lock_init (&frame_table_lock);
+  clock_hand = 0;
+
+  /* Start the pager, keeping its high watermark reachable */
+  sema_init (&pager_wakeup, 0);
+  pager_awake = false;
+  if (frame_pager_high > frame_cnt)
+    frame_pager_high = frame_cnt;
+  if (frame_pager_low > frame_pager_high)
+    frame_pager_low = frame_pager_high;
+  if (frame_pager_low)
+    thread_create ("pager", PRI_DEFAULT, pager_thread, NULL);
 }
 
-frame_table_entry_t *
-evict_one_frame ()
+/* Returns the owner's page directory if FRAME may be evicted, NULL
+   otherwise.  Its page has to be installed there: a frame that is still
+   being loaded is skipped.  So is a frame shared by fork, which other
+   page directories map too.  An exiting process leaves its frames
+   before freeing its sup table, so the sup table entry of a frame
+   found here is still alive. */
+static uint32_t *
+frame_evictable_pagedir (frame_table_entry_t *frame)
 {
-  /* Choose a frame based on LRU */
-  struct list_elem *min_elem
-      = list_min (&frame_table, frame_access_time_less, NULL);
-  frame_table_entry_t *frame
-      = list_entry (min_elem, frame_table_entry_t, elem);
+  struct thread *owner = get_thread (frame->owner);
+  if (owner && owner->pagedir
+      && pagedir_get_page (owner->pagedir, frame->sup_table_entry->addr)
+             == frame->frame_addr
+      && !pagedir_is_shared (frame->frame_addr))
+    return owner->pagedir;
+  return NULL;
+}
+
+/* Returns whether FRAME was referenced since the last call and clears
+   its accessed bits.  A frame is reachable through both its user page
+   and its kernel alias, so both PTEs in the owner's PD are checked. */
+static bool
+frame_test_and_clear_accessed (frame_table_entry_t *frame, uint32_t *pd)
+{
+  void *upage = frame->sup_table_entry->addr;
+  bool accessed = pagedir_is_accessed (pd, upage)
+                  || pagedir_is_accessed (pd, frame->frame_addr);
+  pagedir_set_accessed (pd, upage, false);
+  pagedir_set_accessed (pd, frame->frame_addr, false);
+  return accessed;
+}
+
+/* Choose a victim by second chance: sweep the clock hand and give each
+   referenced frame another round.  After one full sweep every accessed
+   bit is clear, so at most two sweeps are needed.  Store the number of
+   frames examined in SCANNED.  Returns NULL if nothing is evictable. */
+static frame_table_entry_t *
+clock_choose_victim (unsigned *scanned)
+{
+  size_t limit = 2 * frame_cnt;
+  for (*scanned = 0; *scanned < limit;)
+    {
+      /* Advance the hand, wrapping around at the end of frame table */
+      frame_table_entry_t *entry = &frame_table[clock_hand];
+      clock_hand = (clock_hand + 1) % frame_cnt;
+      ++*scanned;
+      if (!entry->frame_addr)
+        continue;
+      uint32_t *pd = frame_evictable_pagedir (entry);
+      if (pd && !frame_test_and_clear_accessed (entry, pd))
+        return entry;
+    }
+  return NULL;
+}
 
+/* Choose the frame with the oldest access time.  Store the number of
+   frames examined in SCANNED.  Returns NULL if nothing is evictable. */
+static frame_table_entry_t *
+lru_choose_victim (unsigned *scanned)
+{
+  frame_table_entry_t *min = NULL;
+  for (size_t i = 0; i < frame_cnt; ++i)
+    {
+      frame_table_entry_t *entry = &frame_table[i];
+      if (entry->frame_addr && frame_evictable_pagedir (entry)
+          && (!min || frame_access_time_less (entry, min)))
+        min = entry;
+    }
+  *scanned = frame_cnt;
+  return min;
+}
+
+/* Choose a frame to evict based on the policy selected at boot and
+   count the eviction.  Returns NULL if nothing is evictable.  Frame
+   table lock must be held. */
+static frame_table_entry_t *
+frame_choose_victim (void)
+{
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  if (!frame_used_cnt)
+    return NULL;
+  unsigned scanned;
+  frame_table_entry_t *frame = frame_evict_policy == FRAME_EVICT_CLOCK
+                                   ? clock_choose_victim (&scanned)
+                                   : lru_choose_victim (&scanned);
+  evict_cnt += frame != NULL;
+  evict_scan_cnt += scanned;
+  if (scanned > evict_scan_max)
+    evict_scan_max = scanned;
+  return frame;
+}
+
+/* Detach FRAME's page from its owner.  The page is unmapped first, so
+   that no write of the owner slips in after the dirty bits are read.
+   Then a clean file-backed page is just dropped, to be read from its
+   file again on the next fault.  A dirty mmap page is written back to
+   its file right away.  Otherwise a swap slot is reserved for the page
+   and stored in SECTOR_IDX, and the caller must write the frame there
+   with write_frame_to_block() before reusing it.  SECTOR_IDX is
+   NOT_IN_SWAP if no swap write is needed.  A fault of the owner on the
+   page waits for frame table lock to get a frame, by then the sup table
+   entry tells where to load the page from.  Returns false, mapping the
+   page again, if swap is full.  Frame table lock must be held. */
+static bool
+frame_detach (frame_table_entry_t *frame, int *sector_idx)
+{
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  uint32_t *pd = get_thread (frame->owner)->pagedir;
+  sup_page_table_entry_t *page = frame->sup_table_entry;
+  *sector_idx = NOT_IN_SWAP;
+  pagedir_clear_page (pd, page->addr);
+  /* The page may have been written through either the owner's mapping or
+     the kernel alias.  load_from_file() clears the latter after loading.
+     Dirty bits survive unmapping */
+  bool dirty = pagedir_is_dirty (pd, page->addr)
+               || pagedir_is_dirty (pd, frame->frame_addr);
+  if (page->from_file && !dirty)
+    {
+      /* Clean, its file still has the same content */
+      evict_drop_cnt++;
+    }
+  else if (page->from_file && page->is_mmap)
+    {
+      /* If from file and dirty, write back the changes, at its offset
+         since the owner may be using the file position */
+      file_write_at (page->file, frame->frame_addr, page->read_bytes,
+                     page->ofs);
+    }
+  else
+    {
+      /* The frame goes to swap space */
+      *sector_idx = get_new_swap_slot ();
+      if (*sector_idx == NOT_IN_SWAP)
+        {
+          /* Map the page again, its content is nowhere else */
+          pagedir_set_page (pd, page->addr, frame->frame_addr,
+                            page->writable);
+          pagedir_set_dirty (pd, page->addr, true);
+          return false;
+        }
+      page->from_file = false;
+      page->swap_idx = *sector_idx;
+    }
+  return true;
+}
+
+/* Give the current thread the page FROM of page directory PD, whose
+   owner waits meanwhile, as TO.  A resident page shares its frame
+   copy-on-write, and the current thread becomes a sharer of its frame
+   table entry.  A swapped out one gets a copy of its slot.  Returns
+   false if out of memory or swap is full. */
+bool
+frame_fork_page (uint32_t *pd, sup_page_table_entry_t *from,
+                 sup_page_table_entry_t *to)
+{
+  struct frame_sharer *sharer = malloc (sizeof *sharer);
+  if (!sharer)
+    return false;
+  /* The page can not be evicted while frame table lock is held */
   lock_acquire (&frame_table_lock);
-  struct thread *cur = thread_current ();
-  /* If from file and dirty, write back the changes */
-  if (frame->sup_table_entry->from_file && frame->sup_table_entry->is_mmap
-      && pagedir_is_dirty (cur->pagedir, frame->sup_table_entry->addr))
-    {
-      lock_acquire (&filesys_lock);
-      /* Seek correct place and write back */
-      file_seek (frame->sup_table_entry->file, frame->sup_table_entry->ofs);
-      file_write (frame->sup_table_entry->file, frame->sup_table_entry->addr,
-                  frame->sup_table_entry->read_bytes);
-      lock_release (&filesys_lock);
+  bool success = true;
+  int swap_idx = NOT_IN_SWAP;
+  to->from_file = from->from_file;
+  void *k_page = pagedir_get_page (pd, from->addr);
+  if (k_page)
+    {
+      success = pagedir_share_page (pd, thread_current ()->pagedir,
+                                    from->addr);
+      frame_table_entry_t *entry = frame_table_lookup (k_page);
+      if (success && entry)
+        {
+          sharer->tid = thread_tid ();
+          sharer->sup_table_entry = to;
+          sharer->next = entry->sharers;
+          entry->sharers = sharer;
+          sharer = NULL;
+        }
     }
   else
+    swap_idx = from->swap_idx;
+  lock_release (&frame_table_lock);
+  free (sharer);
+  /* Not resident, then the page is in its file or its swap slot */
+  if (swap_idx != NOT_IN_SWAP)
+    {
+      to->swap_idx = swap_copy (swap_idx);
+      success = to->swap_idx != NOT_IN_SWAP;
+    }
+  return success;
+}
+
+/* Give the current thread a writable copy of its copy-on-write page
+   UPAGE, whose sup table entry is SUP_ENTRY.  The page keeps its frame
+   instead if nobody shares it any more.  Returns false if out of memory
+   and nothing is evictable. */
+bool
+frame_unshare (void *upage, sup_page_table_entry_t *sup_entry)
+{
+  /* Get the frame of the copy first, getting it may evict */
+  frame_table_entry_t *copy = frame_new_page (sup_entry);
+  if (!copy)
+    return false;
+  void *k_page = copy->frame_addr;
+
+  uint32_t *pd = thread_current ()->pagedir;
+  lock_acquire (&frame_table_lock);
+  /* Evicted meanwhile, possible only if nobody else shared it.  The
+     faulting access will bring it back, writable */
+  void *old = pagedir_get_page (pd, upage);
+  if (old && pagedir_unshare_page (pd, upage, k_page))
     {
-      /* Write the frame to swap space */
-      frame->sup_table_entry->from_file = false;
-      write_frame_to_block (frame);
+      /* The others keep the old frame, which one of them takes over
+         if it was ours */
+      frame_table_entry_t *entry = frame_table_lookup (old);
+      if (entry)
+        frame_table_leave (entry, thread_tid ());
+    }
+  else
+    {
+      /* Taken over the old frame, which may have been some other
+         process's */
+      if (old && !frame_table_lookup (old))
+        new_frame_table_entry (old, thread_tid (), sup_entry);
+      frame_table_remove (copy);
+      palloc_free_page (k_page);
     }
-  pagedir_clear_page (get_thread (frame->owner)->pagedir,
-                      frame->sup_table_entry->addr);
   lock_release (&frame_table_lock);
+  return true;
+}
+
+/* Evict a frame and hand it over to SUP_ENTRY of the current thread.
+   Returns NULL if nothing is evictable or swap is full. */
+frame_table_entry_t *
+evict_one_frame (sup_page_table_entry_t *sup_entry)
+{
+  lock_acquire (&frame_table_lock);
+  frame_table_entry_t *frame = frame_choose_victim ();
+  int sector_idx;
+  if (!frame || !frame_detach (frame, &sector_idx))
+    {
+      lock_release (&frame_table_lock);
+      return NULL;
+    }
+  /* Set tid and sup table entry, nobody else may evict it now as it is
+     not installed yet */
+  frame->owner = thread_tid ();
+  frame->sup_table_entry = sup_entry;
+  lock_release (&frame_table_lock);
+  if (sector_idx != NOT_IN_SWAP)
+    write_frame_to_block (frame->frame_addr, sector_idx);
   return frame;
 }
 
+/* Number of user pool pages not in frame table */
+static size_t
+frame_free_cnt (void)
+{
+  return frame_cnt - frame_used_cnt;
+}
+
+/* Pager thread: whenever woken, clean frames ahead of demand until
+   frame_pager_high of them are free, so that a page fault can take a
+   free frame instead of waiting for a swap write. */
+static void
+pager_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      sema_down (&pager_wakeup);
+      while (frame_free_cnt () < frame_pager_high)
+        {
+          lock_acquire (&frame_table_lock);
+          frame_table_entry_t *frame = frame_choose_victim ();
+          int sector_idx;
+          /* Stop when nothing is evictable or swap is full */
+          if (!frame || !frame_detach (frame, &sector_idx))
+            {
+              lock_release (&frame_table_lock);
+              break;
+            }
+          void *k_page = frame->frame_addr;
+          frame_table_remove (frame);
+          lock_release (&frame_table_lock);
+          /* The frame is out of frame table and unmapped, write it to swap
+             and return it to the user pool */
+          if (sector_idx != NOT_IN_SWAP)
+            write_frame_to_block (k_page, sector_idx);
+          palloc_free_page (k_page);
+          pager_clean_cnt++;
+        }
+      lock_acquire (&frame_table_lock);
+      pager_awake = false;
+      lock_release (&frame_table_lock);
+    }
+}
+
+/* Wake up the pager, if it runs and is not awake yet.  Frame table lock
+   must be held. */
+static void
+pager_wake (void)
+{
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  if (frame_pager_low && !pager_awake)
+    {
+      pager_awake = true;
+      sema_up (&pager_wakeup);
+    }
+}
+
+/* Prints eviction statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %llu evictions (%s), %llu frames scanned, "
+          "%llu avg, %u max per eviction\n",
+          evict_cnt,
+          frame_evict_policy == FRAME_EVICT_CLOCK ? "clock" : "lru",
+          evict_scan_cnt, evict_cnt ? evict_scan_cnt / evict_cnt : 0,
+          evict_scan_max);
+  printf ("Frames: %llu clean file pages dropped instead of swapped\n",
+          evict_drop_cnt);
+  if (frame_pager_low)
+    printf ("Pager: %llu frames cleaned ahead of demand\n",
+            pager_clean_cnt);
+}
+
 bool
-frame_access_time_less (const struct list_elem *a, const struct list_elem *b,
-                        void *aux UNUSED)
+frame_access_time_less (const frame_table_entry_t *frame_a,
+                        const frame_table_entry_t *frame_b)
 {
-  frame_table_entry_t *frame_a = list_entry (a, frame_table_entry_t, elem);
-  frame_table_entry_t *frame_b = list_entry (b, frame_table_entry_t, elem);
   sup_page_table_entry_t *page_a = frame_a->sup_table_entry;
   sup_page_table_entry_t *page_b = frame_b->sup_table_entry;
   bool less_than = page_a->access_time < page_b->access_time;
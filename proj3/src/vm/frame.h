@@ -1,22 +1,54 @@
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 #include <debug.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <list.h>
 #include "vm/page.h"
 #include "threads/thread.h"
 
+/* Page replacement policies. */
+enum frame_evict_policy
+{
+  FRAME_EVICT_LRU,  /* Oldest software access time, full scan. */
+  FRAME_EVICT_CLOCK /* Second chance on hardware accessed bits. */
+};
+
+/* Policy used by evict_one_frame, FRAME_EVICT_LRU by default.
+   Controlled by kernel command-line option "-evict=lru|clock". */
+extern enum frame_evict_policy frame_evict_policy;
+
+/* The pager thread cleans frames once fewer than frame_pager_low are
+   free, until frame_pager_high are.  Disabled while frame_pager_low is
+   0 (default).  Controlled by kernel command-line options "-pl" and
+   "-ph". */
+extern size_t frame_pager_low;
+extern size_t frame_pager_high;
+
+/* A process other than the owner mapping a frame shared by fork */
+struct frame_sharer
+{
+  tid_t tid;                               /* The sharing process */
+  sup_page_table_entry_t *sup_table_entry; /* Its sup table entry */
+  struct frame_sharer *next;               /* Next sharer */
+};
+
+/* Frame table entry.  Frame table is an array with one entry per user
+   pool page, indexed by palloc_user_page_idx() of the frame. */
 typedef struct frame_table_entry
 {
-  void *frame_addr;                        /* Address of frame */
+  void *frame_addr;                        /* Address of frame, NULL if
+                                              the entry is unused */
   tid_t owner;                             /* Owner of the frame */
   sup_page_table_entry_t *sup_table_entry; /* Corresponding sup table entry */
-  struct list_elem elem;                   /* List elem in frame table */
+  struct frame_sharer *sharers;            /* Who else maps it, to take
+                                              over if the owner leaves */
 } frame_table_entry_t;
 
-/* Allocate and initialize a frame table entry */
+/* Take the entry of FRAME_ADDR and initialize it */
 frame_table_entry_t *new_frame_table_entry (void *frame_addr, tid_t owner,
                                             sup_page_table_entry_t *sup_entry);
+/* Find the entry of a frame in O(1), NULL if it is not in frame table */
+frame_table_entry_t *frame_table_lookup (void *frame_addr);
 
 /* Get a new frame and maintain info in frame table */
 frame_table_entry_t *frame_new_page (sup_page_table_entry_t *sup_entry);
@@ -31,14 +63,24 @@ typedef bool (*frame_table_action_func) (frame_table_entry_t *);
 /* For each element in frame table, do some actions in some conditions */
 void frame_table_foreach_if (frame_table_action_cmp if_cmp, void *cmp_val,
                              frame_table_action_func action_func);
-/* Compare entry->frame and page */
-bool frame_table_entry_crspd_frame (frame_table_entry_t *entry,
-                                    void *frame_addr);
+/* Mark an entry unused, frame table lock must be held */
+void frame_table_remove (frame_table_entry_t *entry);
+/* Whether TID owns or shares the frame of ENTRY */
+bool frame_table_mapped_by (frame_table_entry_t *entry, tid_t tid);
+/* Take TID out of ENTRY, handing it over to a sharer if TID owns it */
+void frame_table_leave (frame_table_entry_t *entry, tid_t tid);
 /* Init frame table */
 void frame_table_init (void);
-/* Evict a frame to swap space and return that frame entry */
-frame_table_entry_t *evict_one_frame (void);
+/* Give the current thread the page FROM of page directory PD as TO */
+bool frame_fork_page (uint32_t *pd, sup_page_table_entry_t *from,
+                      sup_page_table_entry_t *to);
+/* Give the current thread a copy of its copy-on-write page UPAGE */
+bool frame_unshare (void *upage, sup_page_table_entry_t *sup_entry);
+/* Evict a frame and hand its entry over to SUP_ENTRY */
+frame_table_entry_t *evict_one_frame (sup_page_table_entry_t *sup_entry);
+/* Print eviction statistics */
+void frame_print_stats (void);
 
-bool frame_access_time_less (const struct list_elem *,
-                             const struct list_elem *, void *aux UNUSED);
+bool frame_access_time_less (const frame_table_entry_t *,
+                             const frame_table_entry_t *);
 #endif
\ No newline at end of file
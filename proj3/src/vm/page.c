@@ -6,11 +6,11 @@
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "filesys/file.h"
 #include <string.h>
 
-extern struct lock filesys_lock;
 extern bool install_page (void *, void *, bool);
 
 sup_page_table_entry_t *
@@ -64,6 +64,58 @@ sup_table_free (sup_page_table_t *table)
   hash_destroy (table, do_sup_table_entry_free);
 }
 
+/* Copy the sup page table of PARENT, which waits meanwhile, into the
+   current thread.  Resident pages share their frames copy-on-write.
+   Memory mappings are not inherited */
+bool
+sup_table_fork (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct hash_iterator i;
+  hash_first (&i, &parent->sup_page_table);
+  while (hash_next (&i))
+    {
+      sup_page_table_entry_t *from
+          = hash_entry (hash_cur (&i), sup_page_table_entry_t, hash_elem);
+      if (from->is_mmap)
+        continue;
+      sup_page_table_entry_t *to
+          = new_sup_table_entry (from->addr, from->access_time);
+      if (!to)
+        return false;
+      /* The other pages from file are from the executable, read it
+         through the own copy of it */
+      to->file = cur->self_file;
+      to->ofs = from->ofs;
+      to->read_bytes = from->read_bytes;
+      to->zero_bytes = from->zero_bytes;
+      to->writable = from->writable;
+      if (hash_insert (&cur->sup_page_table, &to->hash_elem))
+        {
+          free (to);
+          return false;
+        }
+      /* Where the page is now is up to frame table */
+      if (!frame_fork_page (parent->pagedir, from, to))
+        return false;
+    }
+  return true;
+}
+
+/* Give the current thread a writable page of its own at FAULT_ADDR, if
+   it is copy-on-write */
+bool
+unshare_page (void *fault_addr)
+{
+  struct thread *cur = thread_current ();
+  void *upage = pg_round_down (fault_addr);
+  if (!cur->pagedir || !pagedir_is_cow (cur->pagedir, upage))
+    return false;
+  sup_page_table_entry_t *sup_entry
+      = sup_table_find (&cur->sup_page_table, upage);
+  return sup_entry && frame_unshare (upage, sup_entry);
+}
+
 /* Hash func for pages used in sup page table */
 unsigned
 page_hash_func (const struct hash_elem *elem, void *aux UNUSED)
@@ -132,6 +184,8 @@ grow_stack (void *fault_addr)
       = new_sup_table_entry (fault_addr, timer_ticks ());
   if (!table_entry)
     return false;
+  /* Stays writable when it comes back from swap */
+  table_entry->writable = true;
 
   /* Allocate new frame */
   frame_table_entry_t *frame_entry = frame_new_page (table_entry);
@@ -141,8 +195,10 @@ grow_stack (void *fault_addr)
       free (table_entry);
       return false;
     }
-  /* Install new kernel page if success */
+  /* Install new kernel page if success, zeroed as the frame may be
+     evicted from another process */
   void *k_page = frame_entry->frame_addr;
+  memset (k_page, 0, PGSIZE);
   bool success
       = install_page (table_entry->addr, k_page, true)
         && !hash_insert (&cur->sup_page_table, &table_entry->hash_elem);
@@ -156,11 +212,10 @@ grow_stack (void *fault_addr)
   return true;
 }
 
-bool
-load_from_swap (void *addr, sup_page_table_entry_t *table_entry)
+/* Load the page of TABLE_ENTRY from its swap slot into FRAME */
+static bool
+swap_in (frame_table_entry_t *frame, sup_page_table_entry_t *table_entry)
 {
-  /* Get a frame by eviction */
-  frame_table_entry_t *frame = frame_new_page (table_entry);
   lock_acquire (&table_entry->lock);
   /* load data in swap space back to this frame */
   read_frame_from_block (frame, table_entry->swap_idx);
@@ -181,6 +236,16 @@ load_from_swap (void *addr, sup_page_table_entry_t *table_entry)
   return true;
 }
 
+bool
+load_from_swap (void *addr, sup_page_table_entry_t *table_entry)
+{
+  /* Get a frame by eviction */
+  frame_table_entry_t *frame = frame_new_page (table_entry);
+  if (!frame)
+    return false;
+  return swap_in (frame, table_entry);
+}
+
 bool
 lazy_load (struct file *file, int32_t ofs, uint8_t *upage, uint32_t read_bytes,
            uint32_t zero_bytes, bool writable, bool is_mmap)
@@ -231,22 +296,27 @@ load_from_file (void *addr, sup_page_table_entry_t *table_entry)
   frame_table_entry_t *frame_entry = frame_new_page (table_entry);
   if (!frame_entry)
     return false;
+  /* Getting the frame waited for any eviction of the page to finish.  A
+     dirty page from the executable went to swap meanwhile */
+  if (!table_entry->from_file)
+    return swap_in (frame_entry, table_entry);
   lock_acquire (&table_entry->lock);
   void *kernel_page = frame_entry->frame_addr;
-  /* Read content from file */
-  lock_acquire (&filesys_lock);
-  file_seek (table_entry->file, table_entry->ofs);
-  if (file_read (table_entry->file, kernel_page, table_entry->read_bytes)
+  /* Read content from file at its offset, leaving the file position
+     alone, eviction may be writing the file back meanwhile */
+  if (file_read_at (table_entry->file, kernel_page, table_entry->read_bytes,
+                    table_entry->ofs)
       != (int)table_entry->read_bytes)
     {
       frame_free_page (kernel_page);
-      lock_release (&filesys_lock);
       lock_release (&table_entry->lock);
       return false;
     }
-  lock_release (&filesys_lock);
   /* Initialize remaining part of page to 0 */
   memset (kernel_page + table_entry->read_bytes, 0, table_entry->zero_bytes);
+  /* Loading dirtied the kernel alias.  Clear it so that eviction can tell
+     whether the page still matches its file */
+  pagedir_set_dirty (thread_current ()->pagedir, kernel_page, false);
   /* Install page  to page table*/
   if (!install_page (table_entry->addr, kernel_page, table_entry->writable))
     {
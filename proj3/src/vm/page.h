@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include "threads/synch.h"
 
+struct thread;
+
 typedef struct hash sup_page_table_t;
 
 typedef struct sup_page_table_entry
@@ -14,7 +16,9 @@ typedef struct sup_page_table_entry
   uint64_t access_time;       /* Latest time the page is accessed */
   struct hash_elem hash_elem; /* Hash table elem */
   int swap_idx;               /* Index of the begining sector in swap space */
-  bool from_file;             /* Whether the page is from file */
+  bool from_file;             /* Whether the page is from file, i.e. its
+                                 file is its backing store until it is
+                                 dirtied and swapped out */
   struct file *file;          /* File it belongs */
   int32_t ofs;                /* File pointer offset */
   uint32_t read_bytes;        /* Number of bytes read from file */
@@ -35,6 +39,10 @@ sup_page_table_entry_t *new_sup_table_entry (void *addr, uint64_t access_time);
 bool sup_table_init (sup_page_table_t *table);
 /* Free and clean up all elements in the table */
 void sup_table_free (sup_page_table_t *table);
+/* Copy the sup page table of PARENT into the current thread */
+bool sup_table_fork (struct thread *parent);
+/* Give the current thread a page of its own at copy-on-write FAULT_ADDR */
+bool unshare_page (void *fault_addr);
 
 /* Hash func for pages used in sup page table */
 unsigned page_hash_func (const struct hash_elem *elem, void *aux UNUSED);
@@ -1,25 +1,44 @@
 #include "vm/swap.h"
 #include "devices/block.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
-#include "userprog/syscall.h"
+#include "threads/vaddr.h"
 #include <bitmap.h>
 
-/* Swap table: tracking all free swap slots */
+/* Number of sectors in a page sized swap slot */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Swap table: tracking all free swap slots, one bit per slot */
 static struct bitmap *swap_table;
+/* Slots handed out but not written yet, one bit per slot */
+static struct bitmap *swap_busy;
 /* Lock for avoid race condition */
 static struct lock swap_table_lock;
+/* Signaled when a slot is written and stops being busy */
+static struct condition swap_written;
 /* The swap block provided */
 static struct block *global_swap_block;
+/* Next fit cursor: the slot after the one allocated last */
+static size_t swap_cursor;
 
 /* initialize a swap block and swap table */
 bool
 swap_init ()
 {
   global_swap_block = block_get_role (BLOCK_SWAP);
-  swap_table = bitmap_create (block_size (global_swap_block));
+  swap_table
+      = bitmap_create (block_size (global_swap_block) / SECTORS_PER_SLOT);
   if (!swap_table)
     return false;
+  swap_busy = bitmap_create (bitmap_size (swap_table));
+  if (!swap_busy)
+    {
+      bitmap_destroy (swap_table);
+      return false;
+    }
   lock_init (&swap_table_lock);
+  cond_init (&swap_written);
+  swap_cursor = 0;
   return true;
 }
 
@@ -27,13 +46,26 @@ void
 swap_destroy ()
 {
   bitmap_destroy (swap_table);
+  bitmap_destroy (swap_busy);
 }
 
 void
 swap_release (int sector_idx)
+{
+  ASSERT (sector_idx % SECTORS_PER_SLOT == 0);
+  lock_acquire (&swap_table_lock);
+  bitmap_reset (swap_table, sector_idx / SECTORS_PER_SLOT);
+  lock_release (&swap_table_lock);
+}
+
+/* wait until the slot at SECTOR_IDX is written, the pager may still
+   be at it */
+static void
+swap_wait_written (int sector_idx)
 {
   lock_acquire (&swap_table_lock);
-  bitmap_set_multiple (swap_table, sector_idx, 8, false);
+  while (bitmap_test (swap_busy, sector_idx / SECTORS_PER_SLOT))
+    cond_wait (&swap_written, &swap_table_lock);
   lock_release (&swap_table_lock);
 }
 
@@ -41,41 +73,80 @@ swap_release (int sector_idx)
 void
 read_frame_from_block (frame_table_entry_t *frame, int sector_idx)
 {
-  /* sector size is 512B and frame size is 4kB */
-  for (int i = 0; i < 8; ++i)
-    {
-      /* read 8 consecutive sectors */
-      block_read (global_swap_block, sector_idx + i,
-                  frame->frame_addr + (i * BLOCK_SECTOR_SIZE));
-    }
-  /* mark those 8 sectors as unused */
+  swap_wait_written (sector_idx);
+  /* sector size is 512B and frame size is 4kB, read the whole slot in
+     one request */
+  block_read_multiple (global_swap_block, sector_idx, SECTORS_PER_SLOT,
+                       frame->frame_addr);
+  /* mark the slot as unused */
   swap_release (sector_idx);
 }
 
-/* wrtie data in FRAME to en empyt slot */
+/* copy the slot at SECTOR_IDX to a new slot through a kernel page, and
+   return the first sector of the new one.  Returns NOT_IN_SWAP if swap
+   is full or out of memory */
+int
+swap_copy (int sector_idx)
+{
+  void *page = palloc_get_page (0);
+  if (!page)
+    return NOT_IN_SWAP;
+  swap_wait_written (sector_idx);
+  block_read_multiple (global_swap_block, sector_idx, SECTORS_PER_SLOT,
+                       page);
+  int new_idx = get_new_swap_slot ();
+  if (new_idx != NOT_IN_SWAP)
+    write_frame_to_block (page, new_idx);
+  palloc_free_page (page);
+  return new_idx;
+}
+
+/* wrtie the page at FRAME_ADDR to the slot at SECTOR_IDX, which must
+   come from get_new_swap_slot, and wake up readers waiting for it */
 void
-write_frame_to_block (frame_table_entry_t *frame)
+write_frame_to_block (const void *frame_addr, int sector_idx)
 {
-  int sector_idx = get_new_swap_slot ();
-  frame->sup_table_entry->swap_idx = sector_idx;
-  for (int i = 0; i < 8; ++i)
-    {
-      /* write to 8 consecutive sectors */
-      block_write (global_swap_block, sector_idx + i,
-                   frame->frame_addr + (i * BLOCK_SECTOR_SIZE));
-    }
+  /* write the whole slot in one request */
+  block_write_multiple (global_swap_block, sector_idx, SECTORS_PER_SLOT,
+                        frame_addr);
+  lock_acquire (&swap_table_lock);
+  bitmap_reset (swap_busy, sector_idx / SECTORS_PER_SLOT);
+  cond_broadcast (&swap_written, &swap_table_lock);
+  lock_release (&swap_table_lock);
 }
 
-/* get a free swap slots */
+/* Find a slot that is neither used nor still being written, from START
+   on.  Returns BITMAP_ERROR if there is none. */
+static size_t
+swap_scan (size_t start)
+{
+  size_t slot = start;
+  while ((slot = bitmap_scan (swap_table, slot, 1, false)) != BITMAP_ERROR
+         && bitmap_test (swap_busy, slot))
+    slot++;
+  return slot;
+}
+
+/* get a free swap slot, mark it busy until write_frame_to_block writes
+   it, and return its first sector.  Returns NOT_IN_SWAP if swap is
+   full */
 int
 get_new_swap_slot ()
 {
   lock_acquire (&swap_table_lock);
-  /* Find a emptyr slot and filp it to used */
-  size_t sector = bitmap_scan_and_flip (swap_table, 0, 8, false);
-  /* Exit if no empty space */
-  if (sector == BITMAP_ERROR)
-    syscall_exit (-1);
+  /* Find an empty slot from the cursor on, wrapping around once */
+  size_t slot = swap_scan (swap_cursor);
+  if (slot == BITMAP_ERROR)
+    slot = swap_scan (0);
+  /* No empty space */
+  if (slot == BITMAP_ERROR)
+    {
+      lock_release (&swap_table_lock);
+      return NOT_IN_SWAP;
+    }
+  bitmap_mark (swap_table, slot);
+  bitmap_mark (swap_busy, slot);
+  swap_cursor = slot + 1;
   lock_release (&swap_table_lock);
-  return sector;
-}
\ No newline at end of file
+  return slot * SECTORS_PER_SLOT;
+}
@@ -14,9 +14,12 @@ void swap_destroy (void);
 void swap_release (int sector_idx);
 /* Read a frame frow disk */
 void read_frame_from_block (frame_table_entry_t *frame, int sector_idx);
-/* Write a frame frow disk */
-void write_frame_to_block (frame_table_entry_t *frame);
-/* Get a new swap slot */
+/* Write a frame to the slot at sector idx from get_new_swap_slot */
+void write_frame_to_block (const void *frame_addr, int sector_idx);
+/* Copy a slot to a new one, NOT_IN_SWAP if swap is full */
+int swap_copy (int sector_idx);
+/* Get a new swap slot, busy until write_frame_to_block writes it.
+   NOT_IN_SWAP if swap is full */
 int get_new_swap_slot (void);
 
 #endif
@@ -1,137 +1,472 @@
 #include "filesys/cache.h"
-#include "threads/synch.h"
 #include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+/* A bucket of the sector to entry hash index */
+struct buffer_cache_bucket
+{
+  struct lock lock;              /* Guards entries and pin_cnt of them */
+  struct list entries;           /* Entries whose sector hashes here */
+  unsigned long long hit_cnt;    /* Lookups found in the bucket */
+  unsigned long long miss_cnt;   /* Lookups loaded from the disk */
+  unsigned long long ra_cnt;     /* Sectors read ahead */
+  unsigned long long ra_hit_cnt; /* Read ahead sectors used later */
+};
+
 /* Caches, size with 64 */
 static struct buffer_cache caches[MAX_BUFFER_CACHE_SIZE];
-/* Buffer cache lock for synchronization */
-static struct lock buffer_cache_lock;
+/* Hash index from sector to cache entry */
+static struct buffer_cache_bucket buckets[BUFFER_CACHE_BUCKETS];
+/* Serializes eviction and guards the clock hand */
+static struct lock buffer_cache_evict_lock;
+/* Next entry the clock hand looks at */
+static int clock_hand;
 /* Get the fs_device in the filesys.c */
 extern struct block *fs_device;
 
-/* Init a buffer cache entry */
-static void
-buffer_cache_entry_init (struct buffer_cache *entry, block_sector_t sector)
+/* Ring of sectors waiting to be read ahead */
+static block_sector_t prefetch_queue[BUFFER_CACHE_PREFETCH_QUEUE];
+/* Index of the oldest request and number of requests in the ring */
+static int prefetch_head, prefetch_cnt;
+/* Guards the ring */
+static struct lock prefetch_lock;
+/* Signaled when a request is queued */
+static struct condition prefetch_queued;
+
+/* Held while writing behind, so closing waits for the writes */
+static struct lock writebehind_lock;
+/* Where write-behind gathers a run of adjacent dirty sectors */
+static uint8_t *writebehind_buffer;
+/* Sectors written behind and the requests they took */
+static unsigned long long writebehind_cnt, writebehind_batch_cnt;
+/* Dirty victims eviction had to write itself */
+static unsigned long long evict_write_cnt;
+
+/* Get the bucket a sector hashes to */
+static struct buffer_cache_bucket *
+bucket_of (block_sector_t sector)
+{
+  return &buckets[sector % BUFFER_CACHE_BUCKETS];
+}
+
+/* Find the entry of SECTOR in bucket B, whose lock must be held */
+static struct buffer_cache *
+bucket_find (struct buffer_cache_bucket *b, block_sector_t sector)
 {
-  entry->inuse = false;
-  entry->dirty = false;
-  /* Record the sector */
-  entry->sector = sector;
-  /* Update the time to current timer ticks */
-  entry->time = timer_ticks ();
-  /* Load the data from the disk into the cache */
-  block_read (fs_device, sector, entry->data);
+  for (struct list_elem *e = list_begin (&b->entries);
+       e != list_end (&b->entries); e = list_next (e))
+    {
+      struct buffer_cache *entry = list_entry (e, struct buffer_cache, elem);
+      if (entry->sector == sector)
+        return entry;
+    }
+  return NULL;
 }
 
-/* Flush a cache entry into the disk if exists and dirty */
+/* Flush a cache entry into the disk if dirty.  The caller must have it
+   pinned or own it otherwise */
 static void
 buffer_cache_entry_flush (struct buffer_cache *entry)
 {
+  lock_acquire (&entry->lock);
   /* Only when dirty need to write back */
-  if (entry->inuse && entry->dirty)
-    block_write (fs_device, entry->sector, entry->data);
+  if (entry->dirty)
+    {
+      block_write (fs_device, entry->sector, entry->data);
+      entry->dirty = false;
+    }
+  lock_release (&entry->lock);
 }
 
-/* Evict one entry with LRU, return the index */
-static int
+/* Evict one entry with the clock algorithm and return it, out of the
+   index and pinned once for the caller.  Dirty entries are passed over
+   for two rounds of the clock, leaving them to write-behind.  If there
+   is still no clean victim, a dirty victim is written back while it is
+   still in the index, so nobody reads a stale copy of its sector from
+   the disk meanwhile */
+static struct buffer_cache *
 buffer_cache_evict_one (void)
 {
-  /* Init with the first entry */
-  int64_t min_time = caches[0].time;
-  int index = 0;
-  /* Find the min access time */
-  for (int i = 1; i < MAX_BUFFER_CACHE_SIZE; ++i)
+  struct buffer_cache *entry;
+  int scanned = 0;
+
+  lock_acquire (&buffer_cache_evict_lock);
+  for (;; ++scanned)
     {
-      /* Compare the access time and record the min */
-      if (caches[i].time < min_time)
+      /* Everything is pinned, let the users run */
+      if (scanned > 0 && scanned % (2 * MAX_BUFFER_CACHE_SIZE) == 0)
+        thread_yield ();
+      entry = &caches[clock_hand];
+      clock_hand = (clock_hand + 1) % MAX_BUFFER_CACHE_SIZE;
+      if (entry->pin_cnt)
+        continue;
+      /* A free entry */
+      if (!entry->inuse)
+        break;
+      /* Second chance */
+      if (entry->accessed)
+        {
+          entry->accessed = false;
+          continue;
+        }
+      struct buffer_cache_bucket *b = bucket_of (entry->sector);
+      lock_acquire (&b->lock);
+      if (entry->pin_cnt || !entry->inuse)
+        {
+          lock_release (&b->lock);
+          continue;
+        }
+      if (entry->dirty)
         {
-          min_time = caches[i].time;
-          index = i;
+          /* Prefer a clean victim */
+          if (scanned < 2 * MAX_BUFFER_CACHE_SIZE)
+            {
+              lock_release (&b->lock);
+              continue;
+            }
+          /* Write back, then check again */
+          entry->pin_cnt++;
+          lock_release (&b->lock);
+          evict_write_cnt++;
+          buffer_cache_entry_flush (entry);
+          lock_acquire (&b->lock);
+          entry->pin_cnt--;
+          if (entry->pin_cnt || entry->dirty)
+            {
+              lock_release (&b->lock);
+              continue;
+            }
         }
+      /* Take it out of the index */
+      list_remove (&entry->elem);
+      entry->inuse = false;
+      lock_release (&b->lock);
+      break;
     }
-  /* Write back */
-  buffer_cache_entry_flush (&caches[index]);
-  return index;
+  entry->pin_cnt = 1;
+  lock_release (&buffer_cache_evict_lock);
+  return entry;
+}
+
+/* Get the entry of SECTOR, loading it into the cache if missing (from the
+   disk only if LOAD).  Return it pinned and with its lock held.  With
+   PREFETCH a sector already cached is left alone and NULL returned */
+static struct buffer_cache *
+buffer_cache_get (block_sector_t sector, bool load, bool prefetch)
+{
+  struct buffer_cache_bucket *b = bucket_of (sector);
+  struct buffer_cache *entry, *victim;
+
+  lock_acquire (&b->lock);
+  entry = bucket_find (b, sector);
+  if (!entry)
+    {
+      /* Miss, find an entry without holding the bucket */
+      lock_release (&b->lock);
+      victim = buffer_cache_evict_one ();
+      lock_acquire (&b->lock);
+      /* Someone else may have loaded it meanwhile */
+      entry = bucket_find (b, sector);
+      if (!entry)
+        {
+          b->miss_cnt++;
+          victim->inuse = true;
+          victim->dirty = false;
+          /* Unused read-ahead goes first */
+          victim->accessed = !prefetch;
+          victim->prefetched = prefetch;
+          victim->sector = sector;
+          if (prefetch)
+            b->ra_cnt++;
+          /* Hold the entry before publishing it, so that others wait
+             until its data is loaded */
+          lock_acquire (&victim->lock);
+          list_push_back (&b->entries, &victim->elem);
+          lock_release (&b->lock);
+          if (load)
+            block_read (fs_device, sector, victim->data);
+          return victim;
+        }
+      /* Give the victim back as a free entry */
+      victim->pin_cnt = 0;
+    }
+  /* Already cached, nothing to read ahead */
+  if (prefetch)
+    {
+      lock_release (&b->lock);
+      return NULL;
+    }
+  /* Hit */
+  b->hit_cnt++;
+  if (entry->prefetched)
+    {
+      entry->prefetched = false;
+      b->ra_hit_cnt++;
+    }
+  entry->pin_cnt++;
+  entry->accessed = true;
+  lock_release (&b->lock);
+  lock_acquire (&entry->lock);
+  return entry;
+}
+
+/* Unpin an entry whose lock is not held */
+static void
+buffer_cache_put_unlocked (struct buffer_cache *entry)
+{
+  struct buffer_cache_bucket *b = bucket_of (entry->sector);
+  lock_acquire (&b->lock);
+  entry->pin_cnt--;
+  lock_release (&b->lock);
+}
+
+/* Release an entry from buffer_cache_get */
+static void
+buffer_cache_put (struct buffer_cache *entry)
+{
+  lock_release (&entry->lock);
+  buffer_cache_put_unlocked (entry);
+}
+
+/* Read ahead the queued sectors, forever */
+static void
+buffer_cache_prefetch_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      lock_acquire (&prefetch_lock);
+      while (prefetch_cnt == 0)
+        cond_wait (&prefetch_queued, &prefetch_lock);
+      block_sector_t sector = prefetch_queue[prefetch_head];
+      prefetch_head = (prefetch_head + 1) % BUFFER_CACHE_PREFETCH_QUEUE;
+      prefetch_cnt--;
+      lock_release (&prefetch_lock);
+
+      struct buffer_cache *entry = buffer_cache_get (sector, true, true);
+      if (entry)
+        buffer_cache_put (entry);
+    }
+}
+
+/* Orders pinned entries by sector */
+static int
+sector_cmp (const void *a_, const void *b_)
+{
+  const struct buffer_cache *a = *(struct buffer_cache *const *)a_;
+  const struct buffer_cache *b = *(struct buffer_cache *const *)b_;
+  return a->sector < b->sector ? -1 : a->sector > b->sector;
 }
 
-/* Try to find an entry with given sector if no, insert one */
+/* Count the dirty entries, without locking since it is only a hint */
 static int
-buffer_cache_get (block_sector_t sector)
+buffer_cache_dirty_cnt (void)
+{
+  int cnt = 0;
+  for (int i = 0; i < MAX_BUFFER_CACHE_SIZE; ++i)
+    if (caches[i].inuse && caches[i].dirty)
+      cnt++;
+  return cnt;
+}
+
+/* Write back every dirty entry in ascending sector order, each run of
+   adjacent sectors with one request.  The entries stay pinned until
+   their sectors are on the disk, so none is evicted and read back
+   stale meanwhile */
+static void
+buffer_cache_write_behind (void)
 {
-  /* Initialize with -1 for not found */
-  int index = -1, free_index = -1;
-  /* Loop through the cahche to find */
+  struct buffer_cache *dirty[MAX_BUFFER_CACHE_SIZE];
+  int dirty_cnt = 0;
+
+  /* Pin the dirty entries */
   for (int i = 0; i < MAX_BUFFER_CACHE_SIZE; ++i)
     {
-      /* Find a free cache entry */
-      if (free_index == -1 && !caches[i].inuse)
-        free_index = i;
-      /* Find the cache entry whose sector equals to the `sector` */
-      if (caches[i].sector == sector)
+      struct buffer_cache *entry = &caches[i];
+      if (!entry->inuse || !entry->dirty)
+        continue;
+      struct buffer_cache_bucket *b = bucket_of (entry->sector);
+      lock_acquire (&b->lock);
+      if (entry->inuse && entry->dirty)
         {
-          index = i;
-          break;
+          entry->pin_cnt++;
+          dirty[dirty_cnt++] = entry;
         }
+      lock_release (&b->lock);
     }
-  /* Found the given sector */
-  if (index != -1)
+  qsort (dirty, dirty_cnt, sizeof *dirty, sector_cmp);
+
+  for (int start = 0, end; start < dirty_cnt; start = end)
     {
-      /* Update access time */
-      caches[index].time = timer_ticks ();
-      return index;
+      /* Find the run of adjacent sectors from START */
+      for (end = start + 1; end < dirty_cnt; ++end)
+        if (dirty[end]->sector != dirty[end - 1]->sector + 1)
+          break;
+      /* Copy it out, it may be dirtied again while being written */
+      for (int i = start; i < end; ++i)
+        {
+          lock_acquire (&dirty[i]->lock);
+          memcpy (writebehind_buffer + (i - start) * BLOCK_SECTOR_SIZE,
+                  dirty[i]->data, BLOCK_SECTOR_SIZE);
+          dirty[i]->dirty = false;
+          lock_release (&dirty[i]->lock);
+        }
+      block_write_multiple (fs_device, dirty[start]->sector, end - start,
+                            writebehind_buffer);
+      writebehind_cnt += end - start;
+      writebehind_batch_cnt++;
+      for (int i = start; i < end; ++i)
+        buffer_cache_put_unlocked (dirty[i]);
     }
+}
 
-  /* Cache is full, need eviction */
-  if (free_index == -1)
-    free_index = buffer_cache_evict_one ();
-  /* Init the evicted entry */
-  buffer_cache_entry_init (&caches[free_index], sector);
-  return free_index;
+/* Write dirty entries behind the writers, forever.  Every
+   WRITE_BEHIND_PERIOD_TICKS, or sooner once more than
+   WRITE_BEHIND_DIRTY_MAX entries are dirty */
+static void
+buffer_cache_write_behind_thread (void *aux UNUSED)
+{
+  int64_t last_flush = timer_ticks ();
+  for (;;)
+    {
+      timer_sleep (WRITE_BEHIND_CHECK_TICKS);
+      if (buffer_cache_dirty_cnt () > WRITE_BEHIND_DIRTY_MAX
+          || timer_elapsed (last_flush) >= WRITE_BEHIND_PERIOD_TICKS)
+        {
+          lock_acquire (&writebehind_lock);
+          buffer_cache_write_behind ();
+          lock_release (&writebehind_lock);
+          last_flush = timer_ticks ();
+        }
+    }
 }
 
 /* Init buffer cache */
 void
 buffer_cache_init ()
 {
-  lock_init (&buffer_cache_lock);
   memset (caches, 0, sizeof (caches));
+  for (int i = 0; i < MAX_BUFFER_CACHE_SIZE; ++i)
+    lock_init (&caches[i].lock);
+  for (int i = 0; i < BUFFER_CACHE_BUCKETS; ++i)
+    {
+      lock_init (&buckets[i].lock);
+      list_init (&buckets[i].entries);
+      buckets[i].hit_cnt = buckets[i].miss_cnt = 0;
+      buckets[i].ra_cnt = buckets[i].ra_hit_cnt = 0;
+    }
+  lock_init (&buffer_cache_evict_lock);
+  clock_hand = 0;
+  lock_init (&prefetch_lock);
+  cond_init (&prefetch_queued);
+  prefetch_head = prefetch_cnt = 0;
+  thread_create ("readahead", PRI_DEFAULT, buffer_cache_prefetch_thread,
+                 NULL);
+  writebehind_buffer = malloc (MAX_BUFFER_CACHE_SIZE * BLOCK_SECTOR_SIZE);
+  if (writebehind_buffer == NULL)
+    PANIC ("buffer cache write-behind buffer allocation failed");
+  writebehind_cnt = writebehind_batch_cnt = evict_write_cnt = 0;
+  lock_init (&writebehind_lock);
+  thread_create ("writebehind", PRI_DEFAULT,
+                 buffer_cache_write_behind_thread, NULL);
 }
 
 /* Close buffer cache */
 void
 buffer_cache_close ()
 {
-  lock_acquire (&buffer_cache_lock);
+  /* Wait for write-behind in progress and keep it from starting again */
+  lock_acquire (&writebehind_lock);
   /* Flush all */
   for (int i = 0; i < MAX_BUFFER_CACHE_SIZE; ++i)
-    buffer_cache_entry_flush (caches + i);
-  lock_release (&buffer_cache_lock);
+    if (caches[i].inuse)
+      buffer_cache_entry_flush (caches + i);
 }
 
 /* Read with buffer cache */
 void
 buffer_cache_read (block_sector_t sector, void *buffer)
 {
-  lock_acquire (&buffer_cache_lock);
-  /* Get the entry with given sector */
-  int index = buffer_cache_get (sector);
-  /* Just need to copy data in the cache to the buffer */
-  memcpy (buffer, caches[index].data, BLOCK_SECTOR_SIZE);
-  lock_release (&buffer_cache_lock);
+  buffer_cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
 }
 
 /* Write with buffer cache */
 void
 buffer_cache_write (block_sector_t sector, const void *buffer)
 {
-  lock_acquire (&buffer_cache_lock);
-  /* Get the corresponding cache entry */
-  int index = buffer_cache_get (sector);
+  buffer_cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Read SIZE bytes at OFS within SECTOR into BUFFER, copying once straight
+   out of the cache entry */
+void
+buffer_cache_read_at (block_sector_t sector, void *buffer, int ofs,
+                      int size)
+{
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+  /* Get the entry with given sector */
+  struct buffer_cache *entry = buffer_cache_get (sector, true, false);
+  /* Just need to copy data in the cache to the buffer */
+  memcpy (buffer, entry->data + ofs, size);
+  buffer_cache_put (entry);
+}
+
+/* Write SIZE bytes from BUFFER at OFS within SECTOR, copying once
+   straight into the cache entry */
+void
+buffer_cache_write_at (block_sector_t sector, const void *buffer, int ofs,
+                       int size)
+{
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+  /* Get the corresponding cache entry.  A miss needs the rest of the
+     sector from the disk, unless all of it is about to be overwritten */
+  struct buffer_cache *entry
+      = buffer_cache_get (sector, ofs > 0 || size < BLOCK_SECTOR_SIZE,
+                          false);
   /* After write the cache should be dirty */
-  caches[index].dirty = true;
+  entry->dirty = true;
   /* Just need to copy data in the buffer into the cache */
   /* When flushing, write the data into the disk */
-  memcpy (caches[index].data, buffer, BLOCK_SECTOR_SIZE);
-  lock_release (&buffer_cache_lock);
+  memcpy (entry->data + ofs, buffer, size);
+  buffer_cache_put (entry);
+}
+
+/* Queue SECTOR to be read ahead by the I/O thread.  The request is
+   dropped if the queue is full, read-ahead is only a hint */
+void
+buffer_cache_prefetch (block_sector_t sector)
+{
+  lock_acquire (&prefetch_lock);
+  if (prefetch_cnt < BUFFER_CACHE_PREFETCH_QUEUE)
+    {
+      prefetch_queue[(prefetch_head + prefetch_cnt)
+                     % BUFFER_CACHE_PREFETCH_QUEUE]
+          = sector;
+      prefetch_cnt++;
+      cond_signal (&prefetch_queued, &prefetch_lock);
+    }
+  lock_release (&prefetch_lock);
+}
+
+/* Print hit and miss statistics */
+void
+buffer_cache_print_stats (void)
+{
+  unsigned long long hit_cnt = 0, miss_cnt = 0;
+  unsigned long long ra_cnt = 0, ra_hit_cnt = 0;
+  for (int i = 0; i < BUFFER_CACHE_BUCKETS; ++i)
+    {
+      hit_cnt += buckets[i].hit_cnt;
+      miss_cnt += buckets[i].miss_cnt;
+      ra_cnt += buckets[i].ra_cnt;
+      ra_hit_cnt += buckets[i].ra_hit_cnt;
+    }
+  printf ("Buffer cache: %llu hits, %llu misses\n", hit_cnt, miss_cnt);
+  printf ("Read-ahead: %llu sectors, %llu used\n", ra_cnt, ra_hit_cnt);
+  printf ("Write-behind: %llu sectors in %llu requests, "
+          "%llu written by eviction\n",
+          writebehind_cnt, writebehind_batch_cnt, evict_write_cnt);
 }
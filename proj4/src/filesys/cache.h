@@ -1,17 +1,34 @@
 #ifndef FILESYS_CACHE_H
 #define FILESYS_CACHE_H
 #include <stdbool.h>
+#include <list.h>
 #include "devices/block.h"
+#include "threads/synch.h"
 
 /* The buffer cache size, which is 64 */
 #define MAX_BUFFER_CACHE_SIZE 64
+/* Number of buckets in the sector to entry hash index */
+#define BUFFER_CACHE_BUCKETS 16
+/* Number of read-ahead requests the I/O thread queues up */
+#define BUFFER_CACHE_PREFETCH_QUEUE 32
+/* Ticks between two write-behind checks of the dirty entries */
+#define WRITE_BEHIND_CHECK_TICKS 5
+/* Ticks a dirty entry may wait at most before written behind */
+#define WRITE_BEHIND_PERIOD_TICKS 100
+/* Dirty entries to write behind without waiting for the period */
+#define WRITE_BEHIND_DIRTY_MAX (MAX_BUFFER_CACHE_SIZE / 4)
 
 struct buffer_cache
 {
-  bool inuse;                      /* Whether the entry is used */
+  bool inuse;                      /* Whether the entry is in the index */
   bool dirty;                      /* Whether cache is dirty */
-  int64_t time;                    /* Last access time, used in LRU */
+  bool accessed;                   /* Used since the clock hand passed */
+  bool prefetched;                 /* Read ahead and not used since */
+  int pin_cnt;                     /* Users of the entry, never evicted
+                                      while nonzero */
   block_sector_t sector;           /* Store the sector */
+  struct list_elem elem;           /* Element in its hash bucket */
+  struct lock lock;                /* Guards data and dirty */
   uint8_t data[BLOCK_SECTOR_SIZE]; /* Block data */
 };
 
@@ -23,5 +40,15 @@ void buffer_cache_close (void);
 void buffer_cache_read (block_sector_t sector, void *buffer);
 /* Write with buffer cache */
 void buffer_cache_write (block_sector_t sector, const void *buffer);
+/* Read SIZE bytes at OFS within a sector, straight out of the cache */
+void buffer_cache_read_at (block_sector_t sector, void *buffer, int ofs,
+                           int size);
+/* Write SIZE bytes at OFS within a sector, straight into the cache */
+void buffer_cache_write_at (block_sector_t sector, const void *buffer,
+                            int ofs, int size);
+/* Queue a sector to be read ahead into the cache in the background */
+void buffer_cache_prefetch (block_sector_t sector);
+/* Print hit and miss statistics */
+void buffer_cache_print_stats (void);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,10 +1,12 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir
@@ -13,22 +15,123 @@ struct dir
   off_t pos;           /* Current position. */
 };
 
+/* The entries of a directory form an open addressing hash table keyed
+   by name.  An entry lives in the first free slot from the one its name
+   hashes to, so a lookup reads only a few adjacent slots, and iterating
+   over the slots still visits every entry */
+
+/* Slots of the hash table of a new directory */
+#define DIR_MIN_SLOTS 16
+/* Slots an insertion may probe before the table is grown */
+#define DIR_MAX_PROBE 8
+
+/* States of a directory entry.  A removed entry is a tombstone, which
+   lookups probe past since a name beyond it may hash to before it */
+#define DIRENT_FREE 0    /* Never used */
+#define DIRENT_USED 1    /* Holds a file */
+#define DIRENT_REMOVED 2 /* Freed, reusable */
+
 /* A single directory entry. */
 struct dir_entry
 {
   block_sector_t inode_sector; /* Sector number of header. */
   char name[NAME_MAX + 1];     /* Null terminated file name. */
-  bool in_use;                 /* In use or free? */
+  uint8_t in_use;              /* DIRENT_FREE, DIRENT_USED or
+                                  DIRENT_REMOVED, one byte as the
+                                  bool it once was */
 };
 
-/* Search whethr name is already in dir, return -1 if exists, return offset */
-/* that skips the exist entries */
+/* Slots of the dentry cache */
+#define DCACHE_SIZE 128
+/* Inode sector a dentry cache entry has for a name not in the dir */
+#define DCACHE_NEGATIVE ((block_sector_t)-1)
+
+/* A dentry cache entry, a name resolved in a directory */
+struct dcache_entry
+{
+  bool valid;                  /* Holds a name? */
+  block_sector_t dir_sector;   /* Inode sector of the directory. */
+  char name[NAME_MAX + 1];     /* Null terminated file name. */
+  block_sector_t inode_sector; /* Its inode, DCACHE_NEGATIVE if none. */
+};
+
+/* Dentry cache, direct mapped by directory and name */
+static struct dcache_entry dcache[DCACHE_SIZE];
+/* Guards the dentry cache */
+static struct lock dcache_lock;
+
+/* Search whethr name is already in dir, return -1 if exists, -2 for */
+/* error, return offset of the slot to put it in */
 static off_t lookup_and_offset (struct dir *dir, const char *name,
                                 struct dir_entry *e);
 /* Add a entry into the dir, return -1 for error, 0 for already exists */
 /* 1 for success */
 static int dir_add_entry (struct dir *dir, const char *name,
                           block_sector_t inode_sector);
+/* Init the dentry cache */
+void
+dir_init (void)
+{
+  lock_init (&dcache_lock);
+  for (int i = 0; i < DCACHE_SIZE; ++i)
+    dcache[i].valid = false;
+}
+
+/* The dentry cache slot of NAME in the directory at DIR_SECTOR */
+static struct dcache_entry *
+dcache_slot (block_sector_t dir_sector, const char *name)
+{
+  return &dcache[(hash_string (name) ^ hash_int (dir_sector)) % DCACHE_SIZE];
+}
+
+/* Look NAME in the directory at DIR_SECTOR up in the dentry cache.
+   Returns true and sets *INODE_SECTOR if cached, DCACHE_NEGATIVE if
+   cached as not there */
+static bool
+dcache_get (block_sector_t dir_sector, const char *name,
+            block_sector_t *inode_sector)
+{
+  bool found = false;
+  lock_acquire (&dcache_lock);
+  struct dcache_entry *d = dcache_slot (dir_sector, name);
+  if (d->valid && d->dir_sector == dir_sector && !strcmp (d->name, name))
+    {
+      *inode_sector = d->inode_sector;
+      found = true;
+    }
+  lock_release (&dcache_lock);
+  return found;
+}
+
+/* Record in the dentry cache that NAME in the directory at DIR_SECTOR
+   is INODE_SECTOR, or DCACHE_NEGATIVE if not there */
+static void
+dcache_put (block_sector_t dir_sector, const char *name,
+            block_sector_t inode_sector)
+{
+  if (strlen (name) > NAME_MAX)
+    return;
+  lock_acquire (&dcache_lock);
+  struct dcache_entry *d = dcache_slot (dir_sector, name);
+  d->valid = true;
+  d->dir_sector = dir_sector;
+  strlcpy (d->name, name, sizeof d->name);
+  d->inode_sector = inode_sector;
+  lock_release (&dcache_lock);
+}
+
+/* Forget every name cached in the directory at DIR_SECTOR, which is
+   going away and whose sector may be reused, by any kind of inode */
+static void
+dcache_forget_dir (block_sector_t dir_sector)
+{
+  lock_acquire (&dcache_lock);
+  for (int i = 0; i < DCACHE_SIZE; ++i)
+    if (dcache[i].dir_sector == dir_sector)
+      dcache[i].valid = false;
+  lock_release (&dcache_lock);
+}
+
 /* Create a "." dir in the dir, return -1 for error, 0 for already exists */
 /* 1 for success */
 static int
@@ -52,17 +155,19 @@ dir_add_father_entry (struct dir *father, struct dir *child)
   /* ".." is the father */
   return dir_add_entry (child, "..", inode_get_inumber (father->inode));
 }
-/* Check whether dir is empty */
+/* Check whether the dir at INODE is empty, the caller must hold its
+   lock */
 static bool
-dir_is_empty (struct dir *dir)
+dir_is_empty (struct inode *inode)
 {
   struct dir_entry e;
   off_t ofs = 0;
-  for (; inode_read_at (dir->inode, &e, sizeof (e), ofs) == sizeof (e);
+  for (; inode_read_at (inode, &e, sizeof (e), ofs) == sizeof (e);
        ofs += sizeof (e))
     {
       /* Exclude self and parent */
-      if (e.in_use && !(!strcmp (".", e.name) || !strcmp ("..", e.name)))
+      if (e.in_use == DIRENT_USED
+          && !(!strcmp (".", e.name) || !strcmp ("..", e.name)))
         return false;
     }
   return true;
@@ -143,32 +248,106 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Number of slots in the hash table of DIR */
+static size_t
+dir_slot_cnt (const struct dir *dir)
+{
+  return inode_length (dir->inode) / sizeof (struct dir_entry);
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   The caller must hold the lock of DIR's inode. */
 static bool
 lookup (const struct dir *dir, const char *name, struct dir_entry *ep,
         off_t *ofsp)
 {
   struct dir_entry e;
-  size_t ofs;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e)
-    if (e.in_use && !strcmp (name, e.name))
+  /* The dentry cache knows the inode but not the offset.  A removed
+     dir was forgotten by dir_remove and its sector may be reused, so
+     it stays out of the cache while still open */
+  block_sector_t dir_sector = inode_get_inumber (dir->inode);
+  block_sector_t inode_sector;
+  bool cached = !dir->inode->removed;
+  if (cached && ofsp == NULL && dcache_get (dir_sector, name, &inode_sector))
+    {
+      if (inode_sector == DCACHE_NEGATIVE)
+        return false;
+      if (ep != NULL)
+        {
+          ep->inode_sector = inode_sector;
+          strlcpy (ep->name, name, sizeof ep->name);
+          ep->in_use = DIRENT_USED;
+        }
+      return true;
+    }
+
+  size_t slot_cnt = dir_slot_cnt (dir);
+  unsigned hash = hash_string (name);
+  /* Probe from the slot NAME hashes to, up to a slot never used */
+  for (size_t i = 0; i < slot_cnt; ++i)
+    {
+      off_t ofs = (hash + i) % slot_cnt * sizeof e;
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+          || e.in_use == DIRENT_FREE)
+        break;
+      if (e.in_use == DIRENT_USED && !strcmp (name, e.name))
+        {
+          if (cached)
+            dcache_put (dir_sector, name, e.inode_sector);
+          if (ep != NULL)
+            *ep = e;
+          if (ofsp != NULL)
+            *ofsp = ofs;
+          return true;
+        }
+    }
+  if (cached)
+    dcache_put (dir_sector, name, DCACHE_NEGATIVE);
+  return false;
+}
+
+/* Double the hash table of DIR, putting the entries in again and
+   dropping the removed ones.  Returns false on a disk or memory
+   error.  Entries move to new slots, so a readdir position taken
+   before the grow may skip or repeat names after it */
+static bool
+dir_grow (struct dir *dir)
+{
+  size_t old_cnt = dir_slot_cnt (dir);
+  size_t new_cnt = old_cnt * 2 > DIR_MIN_SLOTS ? old_cnt * 2 : DIR_MIN_SLOTS;
+  off_t old_size = old_cnt * sizeof (struct dir_entry);
+  off_t new_size = new_cnt * sizeof (struct dir_entry);
+  struct dir_entry *old = old_cnt ? malloc (old_size) : NULL;
+  struct dir_entry *table = calloc (new_cnt, sizeof *table);
+  bool success = false;
+
+  if (table == NULL || (old_cnt && old == NULL))
+    goto done;
+  if (old_cnt && inode_read_at (dir->inode, old, old_size, 0) != old_size)
+    goto done;
+  /* Rebuild the table in memory, then write it in one go */
+  for (size_t i = 0; i < old_cnt; ++i)
+    if (old[i].in_use == DIRENT_USED)
       {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
+        size_t slot = hash_string (old[i].name) % new_cnt;
+        while (table[slot].in_use == DIRENT_USED)
+          slot = (slot + 1) % new_cnt;
+        table[slot] = old[i];
       }
-  return false;
+  success = inode_write_at (dir->inode, table, new_size, 0) == new_size;
+
+done:
+  free (old);
+  free (table);
+  return success;
 }
 
 /* Searches DIR for a file with the given NAME
@@ -183,35 +362,42 @@ dir_lookup (const struct dir *dir, const char *name, struct inode **inode)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* Open it before the entry can be removed and its sector reused */
+  inode_lock (dir->inode);
   if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
+  inode_unlock (dir->inode);
 
   return *inode != NULL;
 }
 
-/* Search whethr name is already in dir, return -1 if exists, return offset */
-/* that skips the exist entries */
+/* Search whethr name is already in dir, return -1 if exists, -2 for */
+/* error, return offset of the slot to put it in */
 static off_t
 lookup_and_offset (struct dir *dir, const char *name, struct dir_entry *e)
 {
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     return -1; /* -1 for already exists */
-  off_t ofs = 0;
-  /* Set OFS to offset of free slot.
-   If there are no free slots, then it will be set to the
-   current end-of-file.
-
-   inode_read_at() will only return a short read at end of file.
-   Otherwise, we'd need to verify that we didn't get a short
-   read due to something intermittent such as low memory. */
-  for (; inode_read_at (dir->inode, e, sizeof (*e), ofs) == sizeof (*e);
-       ofs += sizeof (*e))
-    if (!e->in_use)
-      break;
-  return ofs;
+  unsigned hash = hash_string (name);
+  for (;;)
+    {
+      /* Find the first free slot from the one NAME hashes to */
+      size_t slot_cnt = dir_slot_cnt (dir);
+      for (size_t i = 0; i < slot_cnt && i < DIR_MAX_PROBE; ++i)
+        {
+          off_t ofs = (hash + i) % slot_cnt * sizeof (*e);
+          if (inode_read_at (dir->inode, e, sizeof (*e), ofs) != sizeof (*e))
+            return -2; /* -2 for error */
+          if (e->in_use != DIRENT_USED)
+            return ofs;
+        }
+      /* Crowded around there, make room */
+      if (!dir_grow (dir))
+        return -2; /* -2 for error */
+    }
 }
 
 /* Add a entry into the dir, return -1 for error, 0 for already exists */
@@ -223,16 +409,26 @@ dir_add_entry (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (!name || *name == '\0' || strlen (name) > NAME_MAX)
     return -1; /* -1 for error */
   struct dir_entry e;
+  int ret = -1;
+  inode_lock (dir->inode);
   off_t ofs = lookup_and_offset (dir, name, &e);
   if (ofs == -1)
-    return 0; /* 0 for alredy exists */
+    ret = 0; /* 0 for alredy exists */
+  /* Nothing new goes into a removed dir */
+  if (ofs < 0 || dir->inode->removed)
+    goto done;
   /* Write slot */
-  e.in_use = true;
+  e.in_use = DIRENT_USED;
   strlcpy (e.name, name, sizeof (e.name));
   e.inode_sector = inode_sector;
   if (inode_write_at (dir->inode, &e, sizeof (e), ofs) != sizeof (e))
-    return -1; /* -1 for error */
-  return 1;    /* 1 for success */
+    goto done;
+  dcache_put (inode_get_inumber (dir->inode), name, inode_sector);
+  ret = 1; /* 1 for success */
+
+done:
+  inode_unlock (dir->inode);
+  return ret;
 }
 
 /* Adds a file named NAME to DIR, which must not already contain a
@@ -274,7 +470,13 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* These are DIR itself and its parent, which would have to be
+     locked out of order */
+  if (!strcmp (name, ".") || !strcmp (name, ".."))
+    return false;
+
   /* Find directory entry. */
+  inode_lock (dir->inode);
   if (!lookup (dir, name, &e, &ofs))
     goto done;
 
@@ -283,47 +485,78 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
-  /* Remove a dir */
-  if (inode->data.is_dir)
+  /* Remove a dir, locked so that nothing is added to it meanwhile */
+  bool is_dir = inode->data.is_dir;
+  if (is_dir)
     {
-      struct dir *child_dir = dir_open (inode);
-      bool is_empty = dir_is_empty (child_dir);
-      dir_close (child_dir);
-      if (!is_empty)
-        goto done;
+      inode_lock (inode);
+      if (!dir_is_empty (inode))
+        {
+          inode_unlock (inode);
+          goto done;
+        }
     }
 
-  /* Erase directory entry. */
-  e.in_use = false;
-  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
-    goto done;
+  /* Erase directory entry, leaving it for lookups to probe past. */
+  e.in_use = DIRENT_REMOVED;
+  if (inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e)
+    {
+      dcache_put (inode_get_inumber (dir->inode), name, DCACHE_NEGATIVE);
+      dcache_forget_dir (inode_get_inumber (inode));
 
-  /* Remove inode. */
-  inode_remove (inode);
-  success = true;
+      /* Remove inode. */
+      inode_remove (inode);
+      success = true;
+    }
+  if (is_dir)
+    inode_unlock (inode);
 
 done:
+  inode_unlock (dir->inode);
   inode_close (inode);
   return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+   contains no more entries.  The position is a byte offset into
+   the hash table, see dir_grow for what that means mid-listing. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  inode_lock (dir->inode);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e)
     {
       dir->pos += sizeof e;
       /* Need to exclude the current and parent directory */
-      if (e.in_use && !(!strcmp (e.name, "..") || !strcmp (e.name, ".")))
+      if (e.in_use == DIRENT_USED
+          && !(!strcmp (e.name, "..") || !strcmp (e.name, ".")))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         }
     }
-  return false;
+  inode_unlock (dir->inode);
+  return found;
+}
+
+/* Sets the readdir position of DIR to POS, as from dir_tell */
+void
+dir_seek (struct dir *dir, off_t pos)
+{
+  ASSERT (dir != NULL);
+  ASSERT (pos >= 0);
+  dir->pos = pos;
+}
+
+/* Returns the readdir position of DIR */
+off_t
+dir_tell (struct dir *dir)
+{
+  ASSERT (dir != NULL);
+  return dir->pos;
 }
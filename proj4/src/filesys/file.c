@@ -1,14 +1,23 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "devices/block.h"
 #include "threads/malloc.h"
 
+/* Read-ahead window of a sequential reader to start with, in sectors */
+#define READAHEAD_MIN 2
+
+int file_readahead_max = 16;
+
 /* An open file. */
 struct file 
   {
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    off_t ra_next;              /* Where a sequential read continues. */
+    off_t ra_end;               /* End of what is already read ahead. */
+    int ra_window;              /* Read-ahead window in sectors. */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +32,8 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
@@ -60,6 +71,41 @@ file_get_inode (struct file *file)
   return file->inode;
 }
 
+/* Notes that SIZE bytes were just read from FILE at POS.  While
+   FILE is read sequentially, reads the next sectors ahead of the
+   reader, doubling the window each time up to file_readahead_max;
+   any other access shuts read-ahead off until it is sequential
+   again. */
+static void
+file_readahead (struct file *file, off_t pos, off_t size)
+{
+  if (file_readahead_max <= 0 || size == 0)
+    return;
+  if (pos != file->ra_next)
+    {
+      /* Random access, start over. */
+      file->ra_window = 0;
+      file->ra_end = 0;
+    }
+  else
+    {
+      file->ra_window = file->ra_window ? file->ra_window * 2
+                                        : READAHEAD_MIN;
+      if (file->ra_window > file_readahead_max)
+        file->ra_window = file_readahead_max;
+      off_t start = pos + size;
+      off_t end = start + file->ra_window * BLOCK_SECTOR_SIZE;
+      if (start < file->ra_end)
+        start = file->ra_end;
+      if (start < end)
+        {
+          inode_readahead (file->inode, start, end);
+          file->ra_end = end;
+        }
+    }
+  file->ra_next = pos + size;
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at the file's current position.
    Returns the number of bytes actually read,
@@ -69,6 +115,7 @@ off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  file_readahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
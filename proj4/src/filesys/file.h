@@ -5,6 +5,10 @@
 
 struct inode;
 
+/* Largest read-ahead window in sectors, 0 to disable read-ahead.
+   Controlled by kernel command-line option "-ra=N". */
+extern int file_readahead_max;
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
@@ -23,14 +23,16 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  /* All file system I/O goes through the buffer cache, formatting too */
+  buffer_cache_init ();
   inode_init ();
+  dir_init ();
   free_map_init ();
 
   if (format)
     do_format ();
 
   free_map_open ();
-  buffer_cache_init ();
 }
 
 /* Shuts down the file system module, writing any unwritten data
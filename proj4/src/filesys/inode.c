@@ -1,11 +1,14 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 #include "filesys/cache.h"
 
 /* Identifies an inode. */
@@ -20,18 +23,18 @@ struct indirect_inode_disk
   block_sector_t blocks[N_INDIRECT_BLOCKS];
 };
 
-/* Wrap block_read, then replace with bvffer_cache_read */
+/* Read a sector through the buffer cache */
 static void
 read_wrapper (block_sector_t sector, void *buffer)
 {
-  block_read (fs_device, sector, buffer);
+  buffer_cache_read (sector, buffer);
 }
 
-/* Wrap block_write, then replace with bvffer_cache_write */
+/* Write a sector through the buffer cache */
 static void
 write_wrapper (block_sector_t sector, const void *buffer)
 {
-  block_write (fs_device, sector, buffer);
+  buffer_cache_write (sector, buffer);
 }
 
 /* Load a indirect_inode_disk from sector */
@@ -42,8 +45,10 @@ load_indirect_inode_disk (struct indirect_inode_disk *node,
   read_wrapper (sector, node);
 }
 
-/* Create inode_disk with `sectors` number of sectors */
-static bool do_inode_create (struct inode_disk *node_disk, size_t sectors);
+/* Create inode_disk with `sectors` number of sectors, allocating them
+   near `goal` */
+static bool do_inode_create (struct inode_disk *node_disk, size_t sectors,
+                             block_sector_t *goal);
 /* Close (destroy) inode_disk with `sectors` number of sectors */
 static bool do_inode_close (struct inode_disk *node_disk, size_t sectors);
 
@@ -55,48 +60,72 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+/* Get entry IDX of the indirect block at SECTOR, through the copy of
+   it in the block map cache MAP, which holds the block at *MAP_SECTOR.
+   The caller must hold the map lock */
+static block_sector_t
+map_lookup (block_sector_t *map, block_sector_t *map_sector,
+            block_sector_t sector, int idx)
+{
+  /* Load the indirect block, unless it is the one cached */
+  if (*map_sector != sector)
+    {
+      load_indirect_inode_disk ((struct indirect_inode_disk *)map, sector);
+      *map_sector = sector;
+    }
+  return map[idx];
+}
+
+/* Forget the indirect blocks cached in INODE, they may have changed */
+static void
+map_invalidate (struct inode *inode)
+{
+  lock_acquire (&inode->map_lock);
+  inode->map_l1_sector = inode->map_l0_sector = 0;
+  lock_release (&inode->map_lock);
+}
+
 /* Get the sector num according to a index */
 static block_sector_t
-index_to_sector (const struct inode_disk *node_disk, off_t index)
+index_to_sector (struct inode *inode, off_t index)
 {
+  const struct inode_disk *node_disk = &inode->data;
+  block_sector_t sector = -1;
+
   /* Inside the direct blocks */
   /* Just return the direct block directly */
   if (index < N_LEVEL0)
     return node_disk->direct_blocks[index];
+  lock_acquire (&inode->map_lock);
   /* Inside level 1 */
   if (index < N_LEVEL1)
     {
       /* First exclude level 0, it has been done previously */
       index -= N_LEVEL0;
-      struct indirect_inode_disk level0_nodes;
-      /* Load the indirect block */
-      load_indirect_inode_disk (&level0_nodes, node_disk->indirect_block);
       /* Get the sector in the indirect block */
-      return level0_nodes.blocks[index];
+      sector = map_lookup (inode->map_l0, &inode->map_l0_sector,
+                           node_disk->indirect_block, index);
     }
   /* Inside level 2 */
-  if (index < N_LEVEL2)
+  else if (index < N_LEVEL2)
     {
       /* First exclude level 0 and level 1 */
       /* They have been done in the previous cases */
       index -= N_LEVEL1;
-      /* Load level 1 nodes (the first indirect level) */
-      struct indirect_inode_disk level1_nodes;
-      load_indirect_inode_disk (&level1_nodes,
-                                node_disk->doubly_indirect_block);
       /* Should be located two steps, first (index / N) then -> (index % N) */
-      int level1_idx = index / N_INDIRECT_BLOCKS;
-      struct indirect_inode_disk level0_nodes;
-      /* Load the second indirect level node */
-      load_indirect_inode_disk (&level0_nodes,
-                                level1_nodes.blocks[level1_idx]);
-      int level0_idx = index % N_INDIRECT_BLOCKS;
+      /* Level 1 nodes (the first indirect level) */
+      block_sector_t level0_sector
+          = map_lookup (inode->map_l1, &inode->map_l1_sector,
+                        node_disk->doubly_indirect_block,
+                        index / N_INDIRECT_BLOCKS);
       /* Get the sector in the second indirect nodes */
-      return level0_nodes.blocks[level0_idx];
+      sector = map_lookup (inode->map_l0, &inode->map_l0_sector,
+                           level0_sector, index % N_INDIRECT_BLOCKS);
     }
+  lock_release (&inode->map_lock);
 
-  /* Not found */
-  return -1;
+  /* -1 if not found */
+  return sector;
 }
 
 /* Returns the block device sector that contains byte offset POS
@@ -104,24 +133,82 @@ index_to_sector (const struct inode_disk *node_disk, off_t index)
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos)
+byte_to_sector (struct inode *inode, off_t pos)
 {
   ASSERT (inode != NULL);
   if (pos < 0 || pos >= inode->data.length)
     return -1;
   off_t idx = pos / BLOCK_SECTOR_SIZE;
-  return index_to_sector (&inode->data, idx);
+  return index_to_sector (inode, idx);
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Number of buckets open inodes are hashed into by sector */
+#define OPEN_INODES_BUCKETS 32
+
+/* Lists of open inodes hashed by sector, so that opening a single
+   inode twice returns the same `struct inode'.
+   Lookups walk a bucket under open_inodes_rcu without locking,
+   insertions and removals are serialized by the lock of the bucket
+   and published with interrupts off, and a removed inode is freed
+   only after a grace period.  lib/kernel/hash.c is not used because
+   its rehashing cannot be done under lookups that take no lock. */
+static struct list open_inodes[OPEN_INODES_BUCKETS];
+static struct lock open_inodes_locks[OPEN_INODES_BUCKETS];
+static struct rcu open_inodes_rcu;
+
+/* Returns the bucket of open inodes for SECTOR. */
+static size_t
+open_inodes_bucket (block_sector_t sector)
+{
+  return hash_int (sector) % OPEN_INODES_BUCKETS;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
-  list_init (&open_inodes);
+  for (size_t i = 0; i < OPEN_INODES_BUCKETS; ++i)
+    {
+      list_init (&open_inodes[i]);
+      lock_init (&open_inodes_locks[i]);
+    }
+  rcu_init (&open_inodes_rcu);
+}
+
+/* Takes a new reference to INODE unless its last opener already
+   dropped it.  Returns true if successful. */
+static bool
+inode_try_reopen (struct inode *inode)
+{
+  enum intr_level old_level = intr_disable ();
+  bool success = inode->open_cnt > 0;
+  if (success)
+    inode->open_cnt++;
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Searches open_inodes for a live inode at SECTOR and returns it
+   with a new reference, or a null pointer if there is none. */
+static struct inode *
+inode_lookup (block_sector_t sector)
+{
+  struct list *bucket = &open_inodes[open_inodes_bucket (sector)];
+  struct list_elem *e;
+  struct inode *found = NULL;
+  int epoch = rcu_read_lock (&open_inodes_rcu);
+
+  for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e))
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector && inode_try_reopen (inode))
+        {
+          found = inode;
+          break;
+        }
+    }
+  rcu_read_unlock (&open_inodes_rcu, epoch);
+  return found;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -149,7 +236,9 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
       disk_inode->magic = INODE_MAGIC;
       disk_inode->is_dir = is_dir;
       /* Wrap to call inode create */
-      if (do_inode_create (disk_inode, sectors))
+      /* Allocate the data right behind the inode */
+      block_sector_t goal = sector + 1;
+      if (do_inode_create (disk_inode, sectors, &goal))
         {
           /* Success, then need to write to disk */
           write_wrapper (sector, disk_inode);
@@ -166,34 +255,48 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  size_t bucket = open_inodes_bucket (sector);
   struct inode *inode;
+  enum intr_level old_level;
 
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e))
+  /* Check whether this inode is already open, without locking. */
+  inode = inode_lookup (sector);
+  if (inode != NULL)
+    return inode;
+
+  /* Check again under the lock, somebody may have opened it. */
+  lock_acquire (&open_inodes_locks[bucket]);
+  inode = inode_lookup (sector);
+  if (inode != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector)
-        {
-          inode_reopen (inode);
-          return inode;
-        }
+      lock_release (&open_inodes_locks[bucket]);
+      return inode;
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_locks[bucket]);
+      return NULL;
+    }
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  lock_init (&inode->map_lock);
+  lock_init (&inode->lock);
+  rw_lock_init (&inode->rw_lock);
+  inode->map_l1_sector = inode->map_l0_sector = 0;
   /* Change to wrapper because of buffer cache */
   read_wrapper (inode->sector, &inode->data);
+  /* Publish to lookups only once fully initialized */
+  old_level = intr_disable ();
+  list_push_front (&open_inodes[bucket], &inode->elem);
+  intr_set_level (old_level);
+  lock_release (&open_inodes_locks[bucket]);
   return inode;
 }
 
@@ -202,7 +305,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      enum intr_level old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -224,10 +331,21 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  enum intr_level old_level = intr_disable ();
+  bool last = --inode->open_cnt == 0;
+  intr_set_level (old_level);
+  if (last)
     {
       /* Remove from inode list and release lock. */
+      struct lock *lock
+          = &open_inodes_locks[open_inodes_bucket (inode->sector)];
+      lock_acquire (lock);
+      old_level = intr_disable ();
       list_remove (&inode->elem);
+      intr_set_level (old_level);
+      lock_release (lock);
+      /* Lookups may still be looking at it */
+      rcu_synchronize (&open_inodes_rcu);
 
       /* Deallocate blocks if removed. */
       if (inode->removed)
@@ -262,8 +380,8 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
+  rw_lock_read_acquire (&inode->rw_lock);
   while (size > 0)
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -280,36 +398,40 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          read_wrapper (sector_idx, buffer + bytes_read);
-        }
-      else
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          /* Change to wrapper because of buffer cache */
-          read_wrapper (sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /* Copy the chunk straight out of the buffer cache. */
+      buffer_cache_read_at (sector_idx, buffer + bytes_read, sector_ofs,
+                            chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  rw_lock_read_release (&inode->rw_lock);
 
   return bytes_read;
 }
 
+/* Queues the sectors holding bytes START through END of INODE to be
+   read into the buffer cache in the background.  Bytes past the end
+   of the file are ignored. */
+void
+inode_readahead (struct inode *inode, off_t start, off_t end)
+{
+  rw_lock_read_acquire (&inode->rw_lock);
+  if (end > inode->data.length)
+    end = inode->data.length;
+  for (off_t pos = ROUND_DOWN (start, BLOCK_SECTOR_SIZE); pos < end;
+       pos += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = byte_to_sector (inode, pos);
+      if (sector == (block_sector_t)-1)
+        break;
+      buffer_cache_prefetch (sector);
+    }
+  rw_lock_read_release (&inode->rw_lock);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
@@ -321,24 +443,40 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
 
   if (inode->deny_write_cnt)
     return 0;
 
   /* Write after EOF */
   /* offset + size - 1 is the end of this write */
+  rw_lock_read_acquire (&inode->rw_lock);
   if (byte_to_sector (inode, offset + size - 1) == -1u)
     {
-      size_t sectors = bytes_to_sectors (offset + size);
-      /* First need to extend the file */
-      /* Just do inode create */
-      if (!do_inode_create (&inode->data, sectors))
-        return 0;
-      /* Update the data length */
-      inode->data.length = offset + size;
-      /* Use wrapper because of buffer cache */
-      write_wrapper (inode->sector, &inode->data);
+      /* Extending changes the block map, no one may be using it */
+      rw_lock_read_release (&inode->rw_lock);
+      rw_lock_write_acquire (&inode->rw_lock);
+      /* Check again, another writer may have extended it meanwhile */
+      if (byte_to_sector (inode, offset + size - 1) == -1u)
+        {
+          size_t sectors = bytes_to_sectors (offset + size);
+          /* First need to extend the file */
+          /* Just do inode create, the goal moves to the last block */
+          block_sector_t goal = inode->sector + 1;
+          bool success = do_inode_create (&inode->data, sectors, &goal);
+          /* New blocks were filled into the indirect blocks */
+          map_invalidate (inode);
+          if (!success)
+            {
+              rw_lock_write_release (&inode->rw_lock);
+              return 0;
+            }
+          /* Update the data length */
+          inode->data.length = offset + size;
+          /* Use wrapper because of buffer cache */
+          write_wrapper (inode->sector, &inode->data);
+        }
+      rw_lock_write_release (&inode->rw_lock);
+      rw_lock_read_acquire (&inode->rw_lock);
     }
 
   while (size > 0)
@@ -357,38 +495,17 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          write_wrapper (sector_idx, buffer + bytes_written);
-        }
-      else
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left)
-            read_wrapper (sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          write_wrapper (sector_idx, bounce);
-        }
+      /* Copy the chunk straight into the buffer cache, which reads in
+         the rest of the sector first if it is not cached. */
+      buffer_cache_write_at (sector_idx, buffer + bytes_written, sector_ofs,
+                             chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+  rw_lock_read_release (&inode->rw_lock);
 
   return bytes_written;
 }
@@ -398,8 +515,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode)
 {
+  lock_acquire (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -408,9 +527,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode)
 {
+  lock_acquire (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&inode->lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -420,29 +541,83 @@ inode_length (const struct inode *inode)
   return inode->data.length;
 }
 
-/* Create a sector and init with zeros */
+/* Locks INODE, so that a directory update made of several reads
+   and writes of it looks atomic to other directory operations. */
+void
+inode_lock (struct inode *inode)
+{
+  lock_acquire (&inode->lock);
+}
+
+/* Unlocks INODE, locked by inode_lock(). */
+void
+inode_unlock (struct inode *inode)
+{
+  lock_release (&inode->lock);
+}
+
+/* Create a sector near *GOAL and init with zeros, then move *GOAL
+   past it */
 static bool
 do_inode_create_sector (block_sector_t *sector,
-                        struct indirect_inode_disk *node)
+                        struct indirect_inode_disk *node,
+                        block_sector_t *goal)
 {
   /* Check whether we need to create */
   if (*sector == 0)
     {
       /* Get a free sector */
-      if (!free_map_allocate (1, sector))
+      if (!free_map_allocate_near (*goal, 1, sector))
         return false;
       /* Init with zeros */
       write_wrapper (*sector, zeros);
     }
+  *goal = *sector + 1;
   /* If used as indirect node, then read the info */
   if (node)
     read_wrapper (*sector, node);
   return true;
 }
 
+/* Create a sector for each of the CNT slots from SLOTS that has none.
+   Each run of missing slots gets a run of contiguous sectors from *GOAL
+   on, split in halves only when the free map has no run that long */
+static bool
+do_inode_create_run (block_sector_t *slots, size_t cnt,
+                     block_sector_t *goal)
+{
+  for (size_t i = 0; i < cnt;)
+    {
+      /* Already there, the next one goes behind it */
+      if (slots[i] != 0)
+        {
+          *goal = slots[i++] + 1;
+          continue;
+        }
+      /* Length of the run of missing slots */
+      size_t n = 1;
+      while (i + n < cnt && slots[i + n] == 0)
+        n++;
+      block_sector_t start;
+      while (!free_map_allocate_near (*goal, n, &start))
+        if ((n /= 2) == 0)
+          return false;
+      /* Init with zeros */
+      for (size_t j = 0; j < n; ++j)
+        {
+          slots[i + j] = start + j;
+          write_wrapper (start + j, zeros);
+        }
+      *goal = start + n;
+      i += n;
+    }
+  return true;
+}
+
 /* Create inode_disk with `sectors` number of sectors */
 static bool
-do_inode_create (struct inode_disk *node_disk, size_t sectors)
+do_inode_create (struct inode_disk *node_disk, size_t sectors,
+                 block_sector_t *goal)
 {
   /* Too many sectors */
   if (sectors > (size_t)N_LEVEL2)
@@ -453,13 +628,13 @@ do_inode_create (struct inode_disk *node_disk, size_t sectors)
     {
       /* Do level 2 */
       /* First create N_LEVEL1 sectors */
-      do_inode_create (node_disk, N_LEVEL1);
+      do_inode_create (node_disk, N_LEVEL1, goal);
       /* Remain sectors */
       sectors -= N_LEVEL1;
       /* L2node -> 128 L1 node */
       struct indirect_inode_disk level1_nodes;
       if (!do_inode_create_sector (&node_disk->doubly_indirect_block,
-                                   &level1_nodes))
+                                   &level1_nodes, goal))
         return false;
       /* Enumerate L1 nodes */
       for (size_t l1_i = 0; l1_i < N_INDIRECT_BLOCKS && sectors > 0; ++l1_i)
@@ -467,16 +642,15 @@ do_inode_create (struct inode_disk *node_disk, size_t sectors)
           struct indirect_inode_disk level0_nodes;
           /* L1 node -> 128 l0 node */
           if (!do_inode_create_sector (&level1_nodes.blocks[l1_i],
-                                       &level0_nodes))
+                                       &level0_nodes, goal))
             return false;
           /* Remain sectors = min(sectors, 128) */
           size_t remain = N_INDIRECT_BLOCKS;
           if (sectors < remain)
             remain = sectors;
           /* Do allocation in L0 nodes */
-          for (size_t l0_i = 0; l0_i < remain; ++l0_i)
-            if (!do_inode_create_sector (&level0_nodes.blocks[l0_i], NULL))
-              return false;
+          if (!do_inode_create_run (level0_nodes.blocks, remain, goal))
+            return false;
           /* The total remaining sectors */
           sectors -= remain;
           /* Record the level data */
@@ -489,25 +663,24 @@ do_inode_create (struct inode_disk *node_disk, size_t sectors)
     {
       /* Do level 1 */
       /* First create N_LEVEL0 sectors */
-      do_inode_create (node_disk, N_LEVEL0);
+      do_inode_create (node_disk, N_LEVEL0, goal);
       /* Remain sectors */
       sectors -= N_LEVEL0;
       /* L1node -> 128 L0 node */
       struct indirect_inode_disk level0_nodes;
-      if (!do_inode_create_sector (&node_disk->indirect_block, &level0_nodes))
+      if (!do_inode_create_sector (&node_disk->indirect_block, &level0_nodes,
+                                   goal))
+        return false;
+      if (!do_inode_create_run (level0_nodes.blocks, sectors, goal))
         return false;
-      for (size_t l0_i = 0; l0_i < sectors; ++l0_i)
-        if (!do_inode_create_sector (&level0_nodes.blocks[l0_i], NULL))
-          return false;
       /* Record the level data */
       write_wrapper (node_disk->indirect_block, &level0_nodes);
     }
   else
     {
       /* Do level 0 */
-      for (size_t i = 0; i < sectors; ++i)
-        if (!do_inode_create_sector (&node_disk->direct_blocks[i], NULL))
-          return false;
+      if (!do_inode_create_run (node_disk->direct_blocks, sectors, goal))
+        return false;
     }
   return true;
 }
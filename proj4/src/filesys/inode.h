@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
+#include "threads/synch.h"
 #include "list.h"
 
 /* Number of direct blocks */
@@ -48,6 +49,19 @@ struct inode
   bool removed;           /* True if deleted, false otherwise. */
   int deny_write_cnt;     /* 0: writes ok, >0: deny writes. */
   struct inode_disk data; /* Inode content. */
+  struct lock lock;       /* Guards deny_write_cnt, and the entries if
+                             a directory. */
+  struct rw_lock rw_lock; /* Held to read or write the data, exclusively
+                             to extend it. */
+
+  /* Block map cache, so indirect blocks are not read per sector. */
+  struct lock map_lock;          /* Guards the block map cache. */
+  block_sector_t map_l1_sector;  /* Doubly indirect block in map_l1,
+                                    0 if none. */
+  block_sector_t map_l0_sector;  /* Indirect block in map_l0, 0 if
+                                    none. */
+  block_sector_t map_l1[N_INDIRECT_BLOCKS]; /* Its sector numbers. */
+  block_sector_t map_l0[N_INDIRECT_BLOCKS]; /* Its sector numbers. */
 };
 
 struct bitmap;
@@ -60,9 +74,12 @@ block_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+void inode_readahead (struct inode *, off_t start, off_t end);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_lock (struct inode *);
+void inode_unlock (struct inode *);
 
 #endif /* filesys/inode.h */
@@ -291,20 +291,39 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+   Whole elements are skipped or counted a word at a time, so a
+   search takes time linear in the bits searched, whatever CNT is. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
+  if (cnt == 0)
+    return start;
   if (cnt <= b->bit_cnt) 
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      /* An element without any bit set to VALUE, and one with all. */
+      elem_type none = value ? 0 : (elem_type) -1;
+      elem_type all = ~none;
+      size_t run = 0;           /* VALUE bits right before I. */
+      size_t i = start;
+
+      while (i < b->bit_cnt)
+        {
+          if (i % ELEM_BITS == 0 && i + ELEM_BITS <= b->bit_cnt
+              && (b->bits[elem_idx (i)] == none
+                  || b->bits[elem_idx (i)] == all))
+            {
+              run = b->bits[elem_idx (i)] == all ? run + ELEM_BITS : 0;
+              i += ELEM_BITS;
+            }
+          else
+            run = bitmap_test (b, i++) == value ? run + 1 : 0;
+          if (run >= cnt)
+            return i - run;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -358,6 +377,24 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the elements of B that hold the bits between START and
+   START + CNT, exclusive, to their place in FILE, which must hold
+   all of B as written by bitmap_write().  Return true if
+   successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  ASSERT (start + cnt <= b->bit_cnt);
+  if (cnt == 0)
+    return true;
+
+  size_t first = elem_idx (start);
+  off_t ofs = first * sizeof (elem_type);
+  off_t size = (elem_idx (start + cnt - 1) - first + 1) * sizeof (elem_type);
+  return file_write_at (file, b->bits + first, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
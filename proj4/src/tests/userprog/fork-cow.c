@@ -0,0 +1,33 @@
+/* Forks a child, which must see a data page and a stack page of
+   the parent as they were at the fork.  Neither process may see
+   what the other one writes to them afterward. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile int data;
+
+void
+test_main (void) 
+{
+  volatile int stack;
+  pid_t pid;
+
+  data = stack = 1;
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* The parent may have written its copies by now, or not */
+      if (data != 1 || stack != 1)
+        fail ("child sees %d and %d, not 1 and 1", data, stack);
+      data = stack = 2;
+      exit (81);
+    }
+  if (pid < 0)
+    fail ("fork() returned %d", pid);
+  data = stack = 3;
+  msg ("wait(fork()) = %d", wait (pid));
+  if (data != 3 || stack != 3)
+    fail ("parent sees %d and %d, not 3 and 3", data, stack);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-once) begin
+(fork-once) child run
+fork-once: exit(81)
+(fork-once) wait(fork()) = 81
+(fork-once) end
+fork-once: exit(0)
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Opens the same file more times than the initial fd table holds,
+   which must grow the table and hand out a different file
+   descriptor each time.  After a close, the lowest free fd must
+   be reused first, and the next open must skip the fds in use. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 40
+
+void
+test_main (void) 
+{
+  int fds[OPEN_CNT];
+  int i, j, fd;
+
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      fds[i] = open ("sample.txt");
+      if (fds[i] < 2)
+        fail ("open #%d returned %d", i, fds[i]);
+      for (j = 0; j < i; j++)
+        if (fds[j] == fds[i])
+          fail ("open #%d and #%d both returned %d", j, i, fds[i]);
+    }
+  msg ("opened \"sample.txt\" %d times", OPEN_CNT);
+  close (fds[3]);
+  fd = open ("sample.txt");
+  if (fd != fds[3])
+    fail ("open after closing %d returned %d", fds[3], fd);
+  msg ("open after a close reused the closed fd");
+  fd = open ("sample.txt");
+  if (fd != 2 + OPEN_CNT)
+    fail ("next open returned %d, not %d", fd, 2 + OPEN_CNT);
+  msg ("next open skipped the fds in use");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) opened "sample.txt" 40 times
+(open-many) open after a close reused the closed fd
+(open-many) next open skipped the fds in use
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
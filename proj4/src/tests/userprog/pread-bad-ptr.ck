@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-bad-ptr) begin
+(pread-bad-ptr) open "sample.txt"
+pread-bad-ptr: exit(-1)
+EOF
+pass;
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-tell) begin
+(pread-tell) create "test.txt"
+(pread-tell) open "test.txt"
+(pread-tell) pwrite "test.txt"
+(pread-tell) pread 20 bytes at 30
+(pread-tell) read 5 bytes
+(pread-tell) end
+pread-tell: exit(0)
+EOF
+pass;
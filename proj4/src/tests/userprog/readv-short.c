@@ -0,0 +1,32 @@
+/* Reads the last 10 bytes of a file into three buffers with
+   readv(), which must stop at the buffer the end of file cuts
+   short and leave the next one alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char a[6], b[20], c[5];
+  struct iovec iov[3] = {{a, sizeof a}, {b, sizeof b}, {c, sizeof c}};
+  int size = sizeof sample - 1;
+  int handle;
+  size_t i;
+
+  memset (c, 'x', sizeof c);
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  seek (handle, size - 10);
+
+  CHECK (readv (handle, iov, 3) == 10, "readv the last 10 bytes");
+  if (memcmp (a, sample + size - 10, 6) || memcmp (b, sample + size - 4, 4))
+    fail ("readv() read wrong data");
+  for (i = 0; i < sizeof c; i++)
+    if (c[i] != 'x')
+      fail ("readv() went on after a short read");
+  if ((int) tell (handle) != size)
+    fail ("tell() returned %u after readv(), not %d", tell (handle), size);
+}
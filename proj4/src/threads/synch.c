@@ -336,3 +336,152 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes readers-writer lock RWL.  Any number of readers may
+   hold it at once, or a single writer.  Waiting writers block new
+   readers, so that writers are not starved. */
+void
+rw_lock_init (struct rw_lock *rwl)
+{
+  ASSERT (rwl != NULL);
+
+  lock_init (&rwl->lock);
+  cond_init (&rwl->readers_ok);
+  cond_init (&rwl->writers_ok);
+  rwl->readers = 0;
+  rwl->writers = 0;
+}
+
+/* Acquires RWL for reading, sleeping while a writer holds it or
+   waits for it. */
+void
+rw_lock_read_acquire (struct rw_lock *rwl)
+{
+  ASSERT (rwl != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwl->lock);
+  while (rwl->writers > 0)
+    cond_wait (&rwl->readers_ok, &rwl->lock);
+  rwl->readers++;
+  lock_release (&rwl->lock);
+}
+
+/* Releases RWL, which the current thread holds for reading. */
+void
+rw_lock_read_release (struct rw_lock *rwl)
+{
+  ASSERT (rwl != NULL);
+
+  lock_acquire (&rwl->lock);
+  ASSERT (rwl->readers > 0);
+  /* The last reader lets a waiting writer in */
+  if (--rwl->readers == 0)
+    cond_signal (&rwl->writers_ok, &rwl->lock);
+  lock_release (&rwl->lock);
+}
+
+/* Acquires RWL for writing, sleeping until there are no readers
+   or other writers.  Returns with RWL's internal lock held. */
+void
+rw_lock_write_acquire (struct rw_lock *rwl)
+{
+  ASSERT (rwl != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwl->lock);
+  rwl->writers++;
+  while (rwl->readers > 0)
+    cond_wait (&rwl->writers_ok, &rwl->lock);
+}
+
+/* Releases RWL, which the current thread holds for writing. */
+void
+rw_lock_write_release (struct rw_lock *rwl)
+{
+  ASSERT (rwl != NULL);
+  ASSERT (lock_held_by_current_thread (&rwl->lock));
+
+  /* Hand over to the next writer parked on writers_ok, if any,
+     otherwise let all blocked readers in */
+  if (--rwl->writers > 0)
+    cond_signal (&rwl->writers_ok, &rwl->lock);
+  else
+    cond_broadcast (&rwl->readers_ok, &rwl->lock);
+  lock_release (&rwl->lock);
+}
+
+/* Initializes read-copy-update domain RCU. */
+void
+rcu_init (struct rcu *rcu)
+{
+  ASSERT (rcu != NULL);
+
+  rcu->epoch = 0;
+  rcu->readers[0] = rcu->readers[1] = 0;
+  rcu->draining = false;
+  sema_init (&rcu->drained, 0);
+  lock_init (&rcu->sync_lock);
+}
+
+/* Enters a read-side critical section of RCU and returns the
+   epoch to pass to rcu_read_unlock().  Never sleeps, so it may be
+   called within an interrupt handler. */
+int
+rcu_read_lock (struct rcu *rcu)
+{
+  enum intr_level old_level;
+  int epoch;
+
+  ASSERT (rcu != NULL);
+
+  old_level = intr_disable ();
+  epoch = rcu->epoch & 1;
+  rcu->readers[epoch]++;
+  intr_set_level (old_level);
+  return epoch;
+}
+
+/* Leaves the read-side critical section of RCU entered in EPOCH. */
+void
+rcu_read_unlock (struct rcu *rcu, int epoch)
+{
+  enum intr_level old_level;
+
+  ASSERT (rcu != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rcu->readers[epoch] > 0);
+  /* The last reader of the old epoch ends the grace period */
+  if (--rcu->readers[epoch] == 0 && rcu->draining
+      && epoch != (int)(rcu->epoch & 1))
+    {
+      rcu->draining = false;
+      sema_up (&rcu->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Waits until every read-side critical section of RCU that was
+   entered before this call has been left. */
+void
+rcu_synchronize (struct rcu *rcu)
+{
+  enum intr_level old_level;
+  int epoch;
+
+  ASSERT (rcu != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rcu->sync_lock);
+  old_level = intr_disable ();
+  /* New readers count in the other epoch from now on */
+  epoch = rcu->epoch++ & 1;
+  if (rcu->readers[epoch] > 0)
+    {
+      rcu->draining = true;
+      sema_down (&rcu->drained);
+    }
+  intr_set_level (old_level);
+  lock_release (&rcu->sync_lock);
+}
@@ -41,6 +41,52 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock.
+   An active writer holds LOCK for its whole critical section, so
+   threads that wait while a writer is in block on a real lock it
+   holds, where priority donation would reach it.  Active readers
+   hold nothing: a writer waiting on WRITERS_OK for them, and
+   readers waiting on READERS_OK behind a queued writer, donate to
+   nobody, so a high priority writer may wait for low priority
+   readers for as long as they read.  This tree schedules in FIFO
+   order and its locks do not donate, so neither side donates
+   yet. */
+struct rw_lock
+  {
+    struct lock lock;            /* Held by the writer, guards fields. */
+    struct condition readers_ok; /* Signaled when writers are done. */
+    struct condition writers_ok; /* Signaled when readers are done. */
+    int readers;                 /* Number of active readers. */
+    int writers;                 /* Number of active/waiting writers. */
+  };
+
+void rw_lock_init (struct rw_lock *);
+void rw_lock_read_acquire (struct rw_lock *);
+void rw_lock_read_release (struct rw_lock *);
+void rw_lock_write_acquire (struct rw_lock *);
+void rw_lock_write_release (struct rw_lock *);
+
+/* Epoch-based read-copy-update.
+   Readers never block: they just count themselves in the current
+   epoch.  An updater unlinks an object, then calls rcu_synchronize()
+   to wait until every reader that could still see it has left,
+   before freeing it.  Updaters must exclude each other by other
+   means, and publish changes atomically with respect to readers,
+   e.g. with interrupts off. */
+struct rcu
+  {
+    unsigned epoch;             /* Current epoch, parity counts readers. */
+    int readers[2];             /* Active readers per epoch parity. */
+    bool draining;              /* A grace period waits on old epoch. */
+    struct semaphore drained;   /* Upped when old epoch has no readers. */
+    struct lock sync_lock;      /* Serializes grace periods. */
+  };
+
+void rcu_init (struct rcu *);
+int rcu_read_lock (struct rcu *);
+void rcu_read_unlock (struct rcu *, int epoch);
+void rcu_synchronize (struct rcu *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
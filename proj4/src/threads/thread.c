@@ -192,6 +192,8 @@ thread_create (const char *name, int priority, thread_func *function,
         return TID_ERROR;
       /* Parent should be the process who create this t process */
       t->parent = thread_current ();
+      /* Into the child list before it can run, or even exit */
+      list_push_back (&t->parent->child_list, &t->process->elem);
     }
 
   /* Stack frame for kernel_thread(). */
@@ -2,8 +2,10 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 
@@ -12,6 +14,8 @@ static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static bool fixup_user_access (struct intr_frame *);
+static bool copy_on_write (void *fault_addr);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -150,6 +154,15 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  /* The first write to a page shared by fork, by the process or by a
+     copy to user memory, gets a copy of the page */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && copy_on_write (fault_addr))
+    return;
+  /* A bad address passed by the process, the copy fails */
+  if (!user && fixup_user_access (f))
+    return;
+
   /* Invalid address */
   if (not_present || (is_kernel_vaddr (fault_addr) && user))
     {
@@ -164,3 +177,129 @@ page_fault (struct intr_frame *f)
           write ? "writing" : "reading", user ? "user" : "kernel");
   kill (f);
 }
+
+/* Makes the copy-on-write page at FAULT_ADDR writable, copying it
+   unless nobody else shares it any more.  Returns false if the page
+   is not copy-on-write or out of memory */
+static bool
+copy_on_write (void *fault_addr)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  void *upage = pg_round_down (fault_addr);
+  if (!pd || !pagedir_is_cow (pd, upage))
+    return false;
+  void *kpage = palloc_get_page (PAL_USER);
+  if (!kpage)
+    return false;
+  /* Not used if the frame turned out to be ours only */
+  if (!pagedir_unshare_page (pd, upage, kpage))
+    palloc_free_page (kpage);
+  return true;
+}
+
+/* The instructions of user_copy() and user_strncpy() that access user
+   memory, and where each resumes if that faults. */
+extern const char user_copy_insn[], user_copy_fixup[];
+extern const char user_strncpy_insn[], user_strncpy_fixup[];
+
+/* Copies SIZE bytes from SRC to DST in one string move.  Returns the
+   number of bytes left uncopied, nonzero only if a fault stopped it. */
+static size_t NO_INLINE
+user_copy (void *dst, const void *src, size_t size)
+{
+  asm volatile (".globl user_copy_insn, user_copy_fixup\n"
+                "user_copy_insn:\n"
+                "rep movsb\n"
+                "user_copy_fixup:"
+                : "+D"(dst), "+S"(src), "+c"(size)
+                :
+                : "memory");
+  return size;
+}
+
+/* Copies the string at SRC to DST, SIZE bytes at most, null
+   terminator included.  Returns the number of bytes copied, or -1
+   if a fault stopped it. */
+static int NO_INLINE
+user_strncpy (char *dst, const char *src, size_t size)
+{
+  char *start = dst;
+  int error = 0;
+  asm volatile (".globl user_strncpy_insn, user_strncpy_fixup\n"
+                "jecxz 2f\n"
+                "1:\n"
+                "user_strncpy_insn:\n"
+                "lodsb\n"
+                "stosb\n"
+                "testb %%al, %%al\n"
+                "loopnz 1b\n"
+                "jmp 2f\n"
+                "user_strncpy_fixup:\n"
+                "movl $-1, %0\n"
+                "2:"
+                : "+d"(error), "+D"(dst), "+S"(src), "+c"(size)
+                :
+                : "eax", "cc", "memory");
+  return error ? -1 : dst - start;
+}
+
+/* If F faulted accessing user memory in user_copy() or
+   user_strncpy(), makes it resume where that fails and returns
+   true.  Returns false for other faults. */
+static bool
+fixup_user_access (struct intr_frame *f)
+{
+  if ((const char *)f->eip == user_copy_insn)
+    f->eip = (void (*) (void))user_copy_fixup;
+  else if ((const char *)f->eip == user_strncpy_insn)
+    f->eip = (void (*) (void))user_strncpy_fixup;
+  else
+    return false;
+  return true;
+}
+
+/* Whether [UADDR, UADDR + SIZE) lies in user memory */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  return (uintptr_t)uaddr + size >= (uintptr_t)uaddr
+         && (uintptr_t)uaddr + size <= (uintptr_t)PHYS_BASE;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns false if
+   USRC is a bad address. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && user_copy (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns false if
+   UDST is a bad address. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && user_copy (udst, src, size) == 0;
+}
+
+/* Copies the string at user address USRC into DST, which has room
+   for SIZE bytes.  Returns the length of the string, SIZE if it
+   does not fit, or -1 if USRC is a bad address. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  if (!is_user_vaddr (usrc))
+    return -1;
+  /* Never read past user memory */
+  size_t room = (const char *)PHYS_BASE - usrc;
+  size_t cnt = size < room ? size : room;
+  int copied = user_strncpy (dst, usrc, cnt);
+  if (copied < 0)
+    return -1;
+  if (copied > 0 && dst[copied - 1] == '\0')
+    return copied - 1;
+  /* Not terminated before the end of user memory */
+  if (cnt < size)
+    return -1;
+  return size;
+}